@@ -19,10 +19,12 @@
 
 #include "config.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "zlfo_common.h"
 #include "zlfo_math.h"
@@ -43,6 +45,50 @@
 #define SAW_ON(x) (*x->saw_on > 0.001f)
 #define CUSTOM_ON(x) (*x->custom_on > 0.001f)
 
+/** Space needed in the forge for each MIDI
+ * event. */
+#define MIDI_EVENT_SIZE \
+  (sizeof (LV2_Atom_Event) + lv2_atom_pad_size (3))
+
+/**
+ * Segment of a waveform that can be reproduced
+ * by linear interpolation within the tolerance.
+ */
+typedef struct BreakpointSegment
+{
+  /** Whether a segment is in progress. */
+  int           active;
+
+  /** Whether the breakpoint for this segment was
+   * already sent, so the slope can no longer
+   * change. */
+  int           committed;
+
+  /** Frame in the current cycle the segment
+   * started at (only valid if not committed). */
+  uint32_t      start_frame;
+
+  float         start_val;
+
+  /** Range of slopes (value per frame) that keep
+   * all the samples so far within the
+   * tolerance. */
+  float         min_slope;
+  float         max_slope;
+
+  /** Frames from the start of the segment to the
+   * next sample. */
+  long          frames;
+} BreakpointSegment;
+
+typedef struct Breakpoint
+{
+  uint32_t      frame;
+  Waveform      wave;
+  float         value;
+  float         slope;
+} Breakpoint;
+
 typedef struct ZLFO
 {
   /** Plugin ports. */
@@ -71,6 +117,14 @@ typedef struct ZLFO
   const float * custom_on;
   const float * nodes[16][3];
   const float * num_nodes;
+  const float * midi_mode;
+  const float * midi_source;
+  const float * midi_channel;
+  const float * midi_cc;
+  const float * midi_max_rate;
+  const float * breakpoints_on;
+  const float * breakpoints_tolerance;
+  const float * ui_update_rate;
 
   /* outputs */
   float *       cv_out;
@@ -79,7 +133,13 @@ typedef struct ZLFO
   float *       triangle_out;
   float *       square_out;
   float *       custom_out;
+  /** Unused, the playhead is sent through the
+   * notify port. Always 0, so that it is defined
+   * but never changes and hosts have nothing to
+   * forward to the UI. */
   float *       sample_to_ui;
+  LV2_Atom_Sequence * midi_out;
+  LV2_Atom_Sequence * breakpoints_out;
 
   /** This is how far we are inside a beat, from 0.0
    * to 1.0. */
@@ -87,12 +147,69 @@ typedef struct ZLFO
 
   ZLfoCommon    common;
 
-  /* FIXME this can be a local variable */
-  LV2_Atom_Forge_Frame notify_frame;
+  /** Forge for the MIDI output. */
+  LV2_Atom_Forge midi_forge;
+
+  /** Last value sent to the MIDI output, or -1. */
+  int           last_midi_val;
+
+  /** Frames since the last MIDI event, used to
+   * limit the event rate. */
+  long          frames_since_midi_event;
+
+  /** Forge for the breakpoint output. */
+  LV2_Atom_Forge breakpoints_forge;
+
+  /** Segment in progress for each waveform. */
+  BreakpointSegment segments[NUM_WAVEFORMS];
+
+  /** Breakpoints found in this cycle, grouped by
+   * waveform and in frame order within each. */
+  Breakpoint    breakpoints[MAX_BREAKPOINTS];
+  int           num_breakpoints;
+
+  /** Nodes of the last cycle and their order, so
+   * that they are only sorted again when they
+   * change. */
+  float         last_nodes[16][3];
+  int           last_num_nodes;
+  NodeIndexElement node_indices[16];
 
   /** Whether the UI is active or not. */
   int           ui_active;
 
+  /** DSP load since the last update. The average
+   * is calculated when sending. */
+  DspLoad       dsp_load;
+  uint64_t      dsp_load_cycles;
+  uint64_t      dsp_load_samples;
+
+  /** Samples processed since instantiation, sent
+   * with the playhead as its timestamp. */
+  int64_t       playhead_time;
+
+  /** Time of the next playhead update. */
+  int64_t       next_playhead_time;
+
+  /** Scope columns not sent to the UI yet, with
+   * the min and max of each waveform, indexed by
+   * the column number modulo SCOPE_RING_SIZE.
+   * Allocated in instantiate(). */
+  float         (*scope)[NUM_WAVEFORMS][2];
+
+  /** Number of columns completed and sent. */
+  uint32_t      scope_written;
+  uint32_t      scope_sent;
+
+  /** Samples in the column being filled, and the
+   * samples it will span. */
+  uint32_t      scope_column_samples;
+  uint32_t      scope_samples_per_column;
+
+  /** Unsent columns in order, for the message.
+   * Holds SCOPE_RING_SIZE - 1 columns. */
+  float *       scope_msg;
+
   /** Temporary variables. */
 
   /* whether the plugin was freerunning in the
@@ -127,6 +244,8 @@ instantiate (
 
   self->common.samplerate = rate;
 
+  zlfo_tables_init ();
+
 #define HAVE_FEATURE(x) \
   (!strcmp(features[i]->URI, x))
 
@@ -154,9 +273,37 @@ instantiate (
   /* map uris */
   map_uris (self->common.map, &self->common.uris);
 
-  /* init atom forge */
+  /* init atom forges */
   lv2_atom_forge_init (
     &self->common.forge, self->common.map);
+  lv2_atom_forge_init (
+    &self->midi_forge, self->common.map);
+  lv2_atom_forge_init (
+    &self->breakpoints_forge, self->common.map);
+
+  /* the ring has a fixed number of columns, and
+   * the columns span more samples for longer
+   * blocks */
+  self->scope =
+    calloc (SCOPE_RING_SIZE, sizeof (*self->scope));
+  self->scope_msg =
+    calloc (
+      (SCOPE_RING_SIZE - 1) * NUM_WAVEFORMS * 2,
+      sizeof (float));
+  if (!self->scope || !self->scope_msg)
+    {
+      free (self->scope);
+      free (self->scope_msg);
+      free (self);
+      return NULL;
+    }
+
+  /* sort the nodes in the first cycle */
+  self->last_num_nodes = -1;
+
+  /* send the first MIDI event immediately */
+  self->last_midi_val = -1;
+  self->frames_since_midi_event = LONG_MAX;
 
   return (LV2_Handle) self;
 }
@@ -299,6 +446,39 @@ connect_port (
     case ZLFO_NUM_NODES:
       self->num_nodes = (float *) data;
       break;
+    case ZLFO_MIDI_OUT:
+      self->midi_out =
+        (LV2_Atom_Sequence *) data;
+      break;
+    case ZLFO_MIDI_MODE:
+      self->midi_mode = (const float *) data;
+      break;
+    case ZLFO_MIDI_SOURCE:
+      self->midi_source = (const float *) data;
+      break;
+    case ZLFO_MIDI_CHANNEL:
+      self->midi_channel = (const float *) data;
+      break;
+    case ZLFO_MIDI_CC:
+      self->midi_cc = (const float *) data;
+      break;
+    case ZLFO_MIDI_MAX_RATE:
+      self->midi_max_rate = (const float *) data;
+      break;
+    case ZLFO_BREAKPOINTS_OUT:
+      self->breakpoints_out =
+        (LV2_Atom_Sequence *) data;
+      break;
+    case ZLFO_BREAKPOINTS_TOGGLE:
+      self->breakpoints_on = (const float *) data;
+      break;
+    case ZLFO_BREAKPOINTS_TOLERANCE:
+      self->breakpoints_tolerance =
+        (const float *) data;
+      break;
+    case ZLFO_UI_UPDATE_RATE:
+      self->ui_update_rate = (const float *) data;
+      break;
     default:
       break;
     }
@@ -315,12 +495,610 @@ connect_port (
     }
 }
 
+static int
+is_wave_on (
+  ZLFO *   self,
+  Waveform wave)
+{
+  switch (wave)
+    {
+    case WAVEFORM_SINE:
+      return SINE_ON (self);
+    case WAVEFORM_TRIANGLE:
+      return TRIANGLE_ON (self);
+    case WAVEFORM_SAW:
+      return SAW_ON (self);
+    case WAVEFORM_SQUARE:
+      return SQUARE_ON (self);
+    case WAVEFORM_CUSTOM:
+      return CUSTOM_ON (self);
+    default:
+      break;
+    }
+  return 0;
+}
+
+static float *
+get_wave_out (
+  ZLFO *   self,
+  Waveform wave)
+{
+  switch (wave)
+    {
+    case WAVEFORM_SINE:
+      return self->sine_out;
+    case WAVEFORM_TRIANGLE:
+      return self->triangle_out;
+    case WAVEFORM_SAW:
+      return self->saw_out;
+    case WAVEFORM_SQUARE:
+      return self->square_out;
+    case WAVEFORM_CUSTOM:
+      return self->custom_out;
+    default:
+      break;
+    }
+  return NULL;
+}
+
+static void
+forge_midi_event (
+  ZLFO *          self,
+  uint32_t        frames,
+  const uint8_t * msg,
+  uint32_t        size)
+{
+  lv2_atom_forge_frame_time (
+    &self->midi_forge, frames);
+  lv2_atom_forge_atom (
+    &self->midi_forge, size,
+    self->common.uris.midi_MidiEvent);
+  lv2_atom_forge_write (
+    &self->midi_forge, msg, size);
+}
+
+/**
+ * Writes the source waveform to the MIDI output.
+ *
+ * The output range is mapped back to the full
+ * MIDI range, so a narrow range does not lose
+ * resolution. An event is only sent when the
+ * quantized value changes, and no more often than
+ * the max rate.
+ */
+static void
+write_midi_out (
+  ZLFO *            self,
+  const LfoParams * params,
+  uint32_t          n_samples)
+{
+  /* set up forge to write directly to the MIDI
+   * output port */
+  LV2_Atom_Forge * forge = &self->midi_forge;
+  const uint32_t midi_capacity =
+    self->midi_out->atom.size;
+  lv2_atom_forge_set_buffer (
+    forge, (uint8_t *) self->midi_out,
+    midi_capacity);
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_sequence_head (forge, &frame, 0);
+
+  MidiOutMode mode =
+    (MidiOutMode)
+    CLAMP (
+      (int) roundf (*self->midi_mode),
+      MIDI_OUT_OFF, NUM_MIDI_OUT_MODES - 1);
+  Waveform source =
+    (Waveform)
+    CLAMP (
+      (int) roundf (*self->midi_source),
+      WAVEFORM_SINE, NUM_WAVEFORMS - 1);
+  if (mode == MIDI_OUT_OFF ||
+      !is_wave_on (self, source))
+    {
+      /* resend the value when re-enabled */
+      self->last_midi_val = -1;
+      lv2_atom_forge_pop (forge, &frame);
+      return;
+    }
+
+  const float * buf = get_wave_out (self, source);
+  uint8_t channel =
+    (uint8_t)
+    (CLAMP (
+       (int) roundf (*self->midi_channel), 1, 16) -
+     1);
+  uint8_t cc =
+    (uint8_t)
+    CLAMP (
+      (int) roundf (*self->midi_cc), 0,
+      /* the LSB goes to cc + 32 */
+      mode == MIDI_OUT_CC_14BIT ? 31 : 127);
+  int max_val = mode == MIDI_OUT_CC ? 127 : 16383;
+  long min_interval =
+    (long)
+    (self->common.samplerate /
+     (double) MAX (*self->midi_max_rate, 1.f));
+  float min_range = params->min_range;
+  float range = params->range;
+
+  for (uint32_t i = 0; i < n_samples; i++)
+    {
+      if (self->frames_since_midi_event <
+            min_interval)
+        {
+          self->frames_since_midi_event++;
+          continue;
+        }
+
+      /* quantize from the output range */
+      float normalized =
+        range > 0.f ?
+          CLAMP (
+            (buf[i] - min_range) / range, 0.f, 1.f) :
+          0.5f;
+      int val =
+        (int) (normalized * (float) max_val + 0.5f);
+      if (val == self->last_midi_val)
+        continue;
+
+      /* stop if there is no space for the
+       * events */
+      if (forge->offset + 2 * MIDI_EVENT_SIZE >
+            forge->size)
+        break;
+
+      uint8_t msg[3];
+      switch (mode)
+        {
+        case MIDI_OUT_CC:
+          msg[0] =
+            (uint8_t)
+            (LV2_MIDI_MSG_CONTROLLER | channel);
+          msg[1] = cc;
+          msg[2] = (uint8_t) val;
+          forge_midi_event (self, i, msg, 3);
+          break;
+        case MIDI_OUT_CC_14BIT:
+          msg[0] =
+            (uint8_t)
+            (LV2_MIDI_MSG_CONTROLLER | channel);
+          msg[1] = cc;
+          msg[2] = (uint8_t) (val >> 7);
+          forge_midi_event (self, i, msg, 3);
+          msg[1] = (uint8_t) (cc + 32);
+          msg[2] = (uint8_t) (val & 0x7F);
+          forge_midi_event (self, i, msg, 3);
+          break;
+        case MIDI_OUT_PITCH_BEND:
+          msg[0] =
+            (uint8_t)
+            (LV2_MIDI_MSG_BENDER | channel);
+          msg[1] = (uint8_t) (val & 0x7F);
+          msg[2] = (uint8_t) (val >> 7);
+          forge_midi_event (self, i, msg, 3);
+          break;
+        default:
+          break;
+        }
+
+      self->last_midi_val = val;
+      self->frames_since_midi_event = 1;
+    }
+
+  lv2_atom_forge_pop (forge, &frame);
+}
+
+static float
+get_segment_slope (
+  BreakpointSegment * seg)
+{
+  /* only 1 sample so far */
+  if (isinf (seg->min_slope) ||
+      isinf (seg->max_slope))
+    return 0.f;
+
+  return (seg->min_slope + seg->max_slope) / 2.f;
+}
+
+static void
+add_breakpoint (
+  ZLFO *              self,
+  Waveform            wave,
+  BreakpointSegment * seg)
+{
+  if (self->num_breakpoints >= MAX_BREAKPOINTS)
+    return;
+
+  Breakpoint * bp =
+    &self->breakpoints[self->num_breakpoints++];
+  bp->frame = seg->start_frame;
+  bp->wave = wave;
+  bp->value = seg->start_val;
+  bp->slope = get_segment_slope (seg);
+}
+
+/**
+ * Splits the given output into segments that can
+ * be reproduced within the tolerance by linear
+ * interpolation and adds a breakpoint at the start
+ * of each one.
+ *
+ * Segments are extended while the slopes that keep
+ * all of their samples within the tolerance
+ * overlap. A segment still in progress at the end
+ * of the cycle gets its breakpoint sent with the
+ * best slope so far, and continues in the next
+ * cycle only while it stays within the tolerance
+ * with that slope.
+ *
+ * If only one of the @p max_breakpoints is left
+ * when a segment starts, it is used for a last
+ * breakpoint holding the value at that frame, and
+ * the rest of the cycle is skipped. The next cycle
+ * then starts with a new segment, so the output is
+ * only inexact until the end of this cycle.
+ */
+static void
+find_breakpoints (
+  ZLFO *        self,
+  Waveform      wave,
+  const float * buf,
+  uint32_t      n_samples,
+  float         tolerance,
+  int           max_breakpoints)
+{
+  BreakpointSegment * seg = &self->segments[wave];
+  int end = self->num_breakpoints + max_breakpoints;
+  for (uint32_t i = 0; i < n_samples; i++)
+    {
+      float val = buf[i];
+      if (seg->active)
+        {
+          float dt = (float) seg->frames;
+          float min_slope =
+            MAX (
+              seg->min_slope,
+              (val - tolerance - seg->start_val) /
+                dt);
+          float max_slope =
+            MIN (
+              seg->max_slope,
+              (val + tolerance - seg->start_val) /
+                dt);
+          if (min_slope <= max_slope)
+            {
+              seg->min_slope = min_slope;
+              seg->max_slope = max_slope;
+              seg->frames++;
+              continue;
+            }
+
+          /* the sample can't be reached, so end the
+           * segment */
+          if (!seg->committed)
+            {
+              add_breakpoint (self, wave, seg);
+            }
+        }
+
+      /* start a new segment */
+      seg->active = 1;
+      seg->committed = 0;
+      seg->start_frame = i;
+      seg->start_val = val;
+      seg->min_slope = - INFINITY;
+      seg->max_slope = INFINITY;
+      seg->frames = 1;
+
+      /* out of space, end here */
+      if (end - self->num_breakpoints <= 1)
+        {
+          if (end - self->num_breakpoints == 1)
+            add_breakpoint (self, wave, seg);
+          seg->active = 0;
+          seg->committed = 0;
+          return;
+        }
+    }
+
+  if (seg->active && !seg->committed)
+    {
+      add_breakpoint (self, wave, seg);
+      seg->committed = 1;
+      seg->min_slope = get_segment_slope (seg);
+      seg->max_slope = seg->min_slope;
+    }
+}
+
+/**
+ * Writes the breakpoints of the enabled waveforms
+ * to the breakpoint output, sorted by frame.
+ */
+static void
+write_breakpoints_out (
+  ZLFO *   self,
+  uint32_t n_samples)
+{
+  /* set up forge to write directly to the
+   * breakpoint output port */
+  LV2_Atom_Forge * forge = &self->breakpoints_forge;
+  const uint32_t capacity =
+    self->breakpoints_out->atom.size;
+  lv2_atom_forge_set_buffer (
+    forge, (uint8_t *) self->breakpoints_out,
+    capacity);
+  LV2_Atom_Forge_Frame seq_frame;
+  lv2_atom_forge_sequence_head (
+    forge, &seq_frame, 0);
+
+  int enabled = *self->breakpoints_on > 0.001f;
+  self->num_breakpoints = 0;
+
+  /* share the breakpoints that fit in the list
+   * and in the buffer between the waveforms */
+  int num_waves = 0;
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      if (enabled && is_wave_on (self, (Waveform) i))
+        num_waves++;
+    }
+  int max_breakpoints = 0;
+  if (num_waves > 0 &&
+      capacity > sizeof (LV2_Atom_Sequence))
+    {
+      max_breakpoints =
+        (int)
+        MIN (
+          (capacity - sizeof (LV2_Atom_Sequence)) /
+            BREAKPOINT_EVENT_SIZE,
+          MAX_BREAKPOINTS) / num_waves;
+    }
+
+  /* the breakpoints of each waveform are found
+   * in frame order, one waveform after another */
+  int next[NUM_WAVEFORMS];
+  int ends[NUM_WAVEFORMS];
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      Waveform wave = (Waveform) i;
+      next[i] = self->num_breakpoints;
+      if (enabled && is_wave_on (self, wave))
+        {
+          find_breakpoints (
+            self, wave, get_wave_out (self, wave),
+            n_samples,
+            MAX (*self->breakpoints_tolerance,
+                 0.00001f),
+            max_breakpoints);
+        }
+      else
+        {
+          self->segments[i].active = 0;
+        }
+      ends[i] = self->num_breakpoints;
+    }
+
+  /* merge them by frame, keeping the waveform
+   * order for equal frames */
+  for (int i = 0; i < self->num_breakpoints; i++)
+    {
+      /* stop if there is no space for the
+       * event */
+      if (forge->offset + BREAKPOINT_EVENT_SIZE >
+            forge->size)
+        break;
+
+      int wave = -1;
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          if (next[j] < ends[j] &&
+              (wave < 0 ||
+               self->breakpoints[next[j]].frame <
+                 self->breakpoints[
+                   next[wave]].frame))
+            wave = j;
+        }
+      Breakpoint * bp =
+        &self->breakpoints[next[wave]++];
+      lv2_atom_forge_frame_time (forge, bp->frame);
+      LV2_Atom_Forge_Frame frame;
+      lv2_atom_forge_object (
+        forge, &frame, 0,
+        self->common.uris.breakpoint);
+      lv2_atom_forge_key (
+        forge,
+        self->common.uris.breakpoint_waveform);
+      lv2_atom_forge_int (forge, (int) bp->wave);
+      lv2_atom_forge_key (
+        forge, self->common.uris.breakpoint_value);
+      lv2_atom_forge_float (forge, bp->value);
+      lv2_atom_forge_key (
+        forge, self->common.uris.breakpoint_slope);
+      lv2_atom_forge_float (forge, bp->slope);
+      lv2_atom_forge_pop (forge, &frame);
+    }
+
+  lv2_atom_forge_pop (forge, &seq_frame);
+}
+
+/**
+ * Returns the number of samples each scope column
+ * should span.
+ *
+ * A period spans at most SCOPE_SIZE columns, and
+ * no more columns are completed between two UI
+ * updates than fit in the ring. Updates are sent
+ * at the end of a cycle, so they can be up to an
+ * update interval plus a cycle apart.
+ */
+static uint32_t
+get_scope_samples_per_column (
+  ZLFO *   self,
+  uint32_t n_samples)
+{
+  float rate =
+    CLAMP (
+      *self->ui_update_rate,
+      MIN_UI_UPDATE_RATE, MAX_UI_UPDATE_RATE);
+  double update_interval =
+    self->common.samplerate / (double) rate;
+  double per_period =
+    ceil (
+      (double) self->common.period_size /
+      SCOPE_SIZE);
+  double per_update =
+    ceil (
+      (update_interval + n_samples) /
+      (SCOPE_RING_SIZE - 2));
+
+  return
+    (uint32_t) MAX (MAX (per_period, per_update), 1.0);
+}
+
+/**
+ * Decimates the outputs into min/max scope
+ * columns.
+ *
+ * The cost is a few vector min/max per waveform
+ * and column, so it is bounded by the block size.
+ */
+static void
+write_scope (
+  ZLFO *   self,
+  float *  outs[NUM_WAVEFORMS],
+  uint32_t n_samples)
+{
+  uint32_t offset = 0;
+  while (offset < n_samples)
+    {
+      float (*column)[2] =
+        self->scope[
+          self->scope_written % SCOPE_RING_SIZE];
+
+      /* start a new column */
+      if (self->scope_column_samples == 0)
+        {
+          self->scope_samples_per_column =
+            get_scope_samples_per_column (
+              self, n_samples);
+          for (int i = 0; i < NUM_WAVEFORMS; i++)
+            {
+              column[i][0] = outs[i][offset];
+              column[i][1] = outs[i][offset];
+            }
+        }
+
+      uint32_t n =
+        MIN (
+          n_samples - offset,
+          self->scope_samples_per_column -
+            self->scope_column_samples);
+      for (int i = 0; i < NUM_WAVEFORMS; i++)
+        {
+          float_array_get_min_max (
+            &outs[i][offset], n,
+            &column[i][0], &column[i][1]);
+        }
+      offset += n;
+      self->scope_column_samples += n;
+
+      if (self->scope_column_samples ==
+            self->scope_samples_per_column)
+        {
+          self->scope_written++;
+          self->scope_column_samples = 0;
+        }
+    }
+}
+
+/**
+ * Returns whether @p size bytes fit in the rest of
+ * the forge buffer.
+ *
+ * Messages are only started if they fit, so a full
+ * buffer never ends up with half an event.
+ */
+static int
+forge_has_space (
+  LV2_Atom_Forge * forge,
+  size_t           size)
+{
+  return forge->offset + size <= forge->size;
+}
+
+/**
+ * Sends the scope columns completed since the last
+ * update.
+ *
+ * If they do not fit in the notify buffer, they
+ * are kept for the next update.
+ */
+static void
+send_scope_to_ui (
+  ZLFO * self)
+{
+  /* drop the oldest columns if the ring
+   * overflowed. the slot of the column being
+   * filled is not sent */
+  uint32_t num_columns =
+    self->scope_written - self->scope_sent;
+  if (num_columns > SCOPE_RING_SIZE - 1)
+    {
+      num_columns = SCOPE_RING_SIZE - 1;
+      self->scope_sent =
+        self->scope_written - num_columns;
+    }
+  LV2_Atom_Forge * forge = &self->common.forge;
+  if (num_columns == 0 ||
+      !forge_has_space (
+        forge, SCOPE_EVENT_SIZE (num_columns)) ||
+      !lv2_atom_forge_frame_time (forge, 0))
+    return;
+
+  for (uint32_t i = 0; i < num_columns; i++)
+    {
+      memcpy (
+        &self->scope_msg[i * NUM_WAVEFORMS * 2],
+        self->scope[
+          (self->scope_sent + i) % SCOPE_RING_SIZE],
+        sizeof (self->scope[0]));
+    }
+  self->scope_sent = self->scope_written;
+
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_object (
+    forge, &frame, 0, self->common.uris.scope);
+
+  lv2_atom_forge_key (
+    forge,
+    self->common.uris.scope_samples_per_column);
+  lv2_atom_forge_int (
+    forge,
+    (int32_t) self->scope_samples_per_column);
+  lv2_atom_forge_key (
+    forge, self->common.uris.scope_columns);
+  lv2_atom_forge_vector (
+    forge, sizeof (float),
+    self->common.uris.atom_Float,
+    num_columns * NUM_WAVEFORMS * 2,
+    self->scope_msg);
+
+  /* finish object */
+  lv2_atom_forge_pop (forge, &frame);
+}
+
 static void
 send_position_to_ui (
   ZLFO *  self)
 {
+  if (!forge_has_space (
+        &self->common.forge, POSITION_EVENT_SIZE) ||
+      !lv2_atom_forge_frame_time (
+        &self->common.forge, 0))
+    return;
+
   /* forge container object of type time_Position */
-  lv2_atom_forge_frame_time (&self->common.forge, 0);
   LV2_Atom_Forge_Frame frame;
   lv2_atom_forge_object (
     &self->common.forge, &frame, 0,
@@ -366,20 +1144,13 @@ send_messages_to_ui (
   ZLFO * self,
   int    send_position)
 {
-  /* set up forge to write directly to notify
-   * output port */
-  const uint32_t notify_capacity =
-    self->notify->atom.size;
-  lv2_atom_forge_set_buffer (
-    &self->common.forge, (uint8_t*) self->notify,
-    notify_capacity);
-
-  /* start a sequence in the notify output port */
-  lv2_atom_forge_sequence_head (
-    &self->common.forge, &self->notify_frame, 0);
+  if (!forge_has_space (
+        &self->common.forge, UI_STATE_EVENT_SIZE) ||
+      !lv2_atom_forge_frame_time (
+        &self->common.forge, 0))
+    return;
 
   /* forge container object of type "ui_state" */
-  lv2_atom_forge_frame_time (&self->common.forge, 0);
   LV2_Atom_Forge_Frame frame;
   lv2_atom_forge_object (
     &self->common.forge, &frame, 0,
@@ -432,6 +1203,123 @@ send_messages_to_ui (
     }
 }
 
+#ifdef HAVE_CYCLE_COUNTER
+/**
+ * Adds the cost of a cycle to the DSP load
+ * statistics.
+ */
+static void
+update_dsp_load (
+  ZLFO *   self,
+  uint64_t cycles,
+  uint32_t n_samples)
+{
+  if (n_samples == 0)
+    return;
+
+  DspLoad * load = &self->dsp_load;
+  float cycles_per_sample =
+    (float) cycles / (float) n_samples;
+  if (load->num_blocks == 0 ||
+      cycles_per_sample < load->min)
+    load->min = cycles_per_sample;
+  if (load->num_blocks == 0 ||
+      cycles_per_sample > load->max)
+    load->max = cycles_per_sample;
+  load->num_blocks++;
+
+  int bucket = 0;
+  float bucket_end = DSP_LOAD_HISTOGRAM_START;
+  while (bucket < DSP_LOAD_HISTOGRAM_SIZE - 1 &&
+         cycles_per_sample >= bucket_end)
+    {
+      bucket++;
+      bucket_end *= 2.f;
+    }
+  load->histogram[bucket]++;
+
+  self->dsp_load_cycles += cycles;
+  self->dsp_load_samples += n_samples;
+}
+#endif
+
+static void
+send_dsp_load_to_ui (
+  ZLFO * self)
+{
+  DspLoad * load = &self->dsp_load;
+  load->avg =
+    (float)
+    ((double) self->dsp_load_cycles /
+     (double) self->dsp_load_samples);
+
+  /* forge container object of type dsp_load */
+  LV2_Atom_Forge * forge = &self->common.forge;
+  if (!forge_has_space (forge, DSP_LOAD_EVENT_SIZE) ||
+      !lv2_atom_forge_frame_time (forge, 0))
+    return;
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_object (
+    forge, &frame, 0,
+    self->common.uris.dsp_load);
+
+  lv2_atom_forge_key (
+    forge, self->common.uris.dsp_load_min);
+  lv2_atom_forge_float (forge, load->min);
+  lv2_atom_forge_key (
+    forge, self->common.uris.dsp_load_avg);
+  lv2_atom_forge_float (forge, load->avg);
+  lv2_atom_forge_key (
+    forge, self->common.uris.dsp_load_max);
+  lv2_atom_forge_float (forge, load->max);
+  lv2_atom_forge_key (
+    forge, self->common.uris.dsp_load_num_blocks);
+  lv2_atom_forge_int (forge, load->num_blocks);
+  lv2_atom_forge_key (
+    forge, self->common.uris.dsp_load_histogram);
+  lv2_atom_forge_vector (
+    forge, sizeof (int32_t),
+    self->common.uris.atom_Int,
+    DSP_LOAD_HISTOGRAM_SIZE, load->histogram);
+
+  /* finish object */
+  lv2_atom_forge_pop (forge, &frame);
+}
+
+/**
+ * Sends the current position in the period.
+ */
+static void
+send_playhead_to_ui (
+  ZLFO * self)
+{
+  LV2_Atom_Forge * forge = &self->common.forge;
+  if (!forge_has_space (forge, PLAYHEAD_EVENT_SIZE) ||
+      !lv2_atom_forge_frame_time (forge, 0))
+    return;
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_object (
+    forge, &frame, 0,
+    self->common.uris.playhead);
+
+  lv2_atom_forge_key (
+    forge,
+    self->common.uris.playhead_current_sample);
+  lv2_atom_forge_long (
+    forge, self->common.current_sample);
+  lv2_atom_forge_key (
+    forge, self->common.uris.playhead_period_size);
+  lv2_atom_forge_long (
+    forge, self->common.period_size);
+  lv2_atom_forge_key (
+    forge, self->common.uris.playhead_time);
+  lv2_atom_forge_long (
+    forge, self->playhead_time);
+
+  /* finish object */
+  lv2_atom_forge_pop (forge, &frame);
+}
+
 static void
 activate (
   LV2_Handle instance)
@@ -450,6 +1338,14 @@ run (
 {
   ZLFO * self = (ZLFO *) instance;
 
+  /* avoid subnormal slowdowns for the duration
+   * of the cycle */
+  uint64_t fp_state = disable_denormals ();
+
+#ifdef HAVE_CYCLE_COUNTER
+  uint64_t start_cycles = get_cycle_count ();
+#endif
+
   int xport_changed = 0;
 
   /* read incoming events from host and UI */
@@ -474,6 +1370,10 @@ run (
             {
               self->ui_active = 1;
               self->first_run_with_ui = 1;
+
+              /* start the scope from scratch */
+              self->scope_column_samples = 0;
+              self->scope_sent = self->scope_written;
             }
           else if (obj->body.otype ==
                      self->common.uris.ui_off)
@@ -511,35 +1411,62 @@ run (
       recalc_multipliers (self);
     }
 
-  float max_range =
-    MAX (*self->range_max, *self->range_min);
-  float min_range =
-    MIN (*self->range_max, *self->range_min);
-  float range = max_range - min_range;
-
-  float grid_step_divisor =
-    (float)
-    grid_step_to_divisor (
-      (GridStep) *self->grid_step);
-  long step_frames =
-    (long)
-    ((float) self->common.period_size /
-     grid_step_divisor);
-
-  /* sort node curves by position */
-  NodeIndexElement node_indices[
-    (int) *self->num_nodes];
-  float nodes[16][3];
+  /* take a snapshot of the parameters for this
+   * cycle */
+  LfoParams params;
+  params.period_size = self->common.period_size;
+  params.sine_multiplier =
+    self->common.sine_multiplier;
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      params.enabled[i] =
+        is_wave_on (self, (Waveform) i);
+    }
+  params.hinvert = *self->hinvert >= 0.01f;
+  params.vinvert = *self->vinvert >= 0.01f;
+  params.step_mode = IS_STEP_MODE (self);
+  params.gated_mode = IS_GATED_MODE (self);
+  params.gate = IS_GATED (self);
+  params.shift = *self->shift;
+  params.range_min = *self->range_min;
+  params.range_max = *self->range_max;
+  params.grid_step = (GridStep) *self->grid_step;
+  params.num_nodes =
+    CLAMP ((int) *self->num_nodes, 1, 16);
   for (int i = 0; i < 16; i++)
     {
       for (int j = 0; j < 3; j++)
         {
-          nodes[i][j] = *(self->nodes[i][j]);
+          params.nodes[i][j] = *(self->nodes[i][j]);
         }
     }
-  sort_node_indices_by_pos (
-    nodes, node_indices,
-    (int) *self->num_nodes);
+  prepare_params_except_nodes (&params);
+
+  /* the UI writes the nodes at most once per
+   * frame while dragging, so most cycles reuse the
+   * last order */
+  if (params.num_nodes != self->last_num_nodes ||
+      memcmp (
+        params.nodes, self->last_nodes,
+        sizeof (params.nodes)) != 0)
+    {
+      sort_node_indices_by_pos (
+        params.nodes, self->node_indices,
+        params.num_nodes);
+      memcpy (
+        self->last_nodes, params.nodes,
+        sizeof (params.nodes));
+      self->last_num_nodes = params.num_nodes;
+    }
+  memcpy (
+    params.node_indices, self->node_indices,
+    sizeof (params.node_indices));
+
+  float * outs[NUM_WAVEFORMS];
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      outs[i] = get_wave_out (self, (Waveform) i);
+    }
 
   /* handle control trigger */
   if (IS_TRIGGERED (self))
@@ -547,146 +1474,22 @@ run (
       self->common.current_sample = 0;
     }
 
+  float values[NUM_WAVEFORMS];
   for (uint32_t i = 0; i < n_samples; i++)
     {
       /* handle cv trigger */
       if (self->cv_trigger[i] > 0.00001f)
         self->common.current_sample = 0;
 
-      /* invert horizontally */
-      long shifted_current_sample =
-        invert_and_shift_xval (
-          self->common.current_sample,
-          self->common.period_size,
-          *self->hinvert >= 0.01f,
-          *self->shift);
-
-      if (IS_STEP_MODE (self))
-        {
-          /* find closest step and set the current
-           * sample to the middle of it */
-          shifted_current_sample =
-            (shifted_current_sample / step_frames) *
-              step_frames +
-            step_frames / 2;
-        }
-
-      float ratio =
-         (float) shifted_current_sample /
-         (float) self->common.period_size;
-
-      if (SINE_ON (self))
-        {
-          /* calculate sine */
-          self->sine_out[i] =
-            sinf (
-              ((float) shifted_current_sample *
-                  self->common.sine_multiplier));
-        }
-      if (SAW_ON (self))
-        {
-          /* calculate saw */
-          self->saw_out[i] =
-            (1.f - ratio) * 2.f - 1.f;
-        }
-      if (TRIANGLE_ON (self))
-        {
-          if (ratio > 0.4999f)
-            {
-              self->triangle_out[i] =
-                (1.f - ratio) * 4.f - 1.f;
-            }
-          else
-            {
-              self->triangle_out[i] =
-                ratio * 4.f - 1.f;
-            }
-        }
-      if (SQUARE_ON (self))
-        {
-          if (ratio > 0.4999f)
-            {
-              self->square_out[i] = - 1.f;
-            }
-          else
-            {
-              self->square_out[i] = 1.f;
-            }
-        }
-      if (CUSTOM_ON (self))
+      get_values_at_sample (
+        &params, self->common.current_sample,
+        params.gate || self->cv_gate[i] > 0.001f,
+        values);
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
         {
-          int prev_idx =
-            get_prev_idx (
-              node_indices, (int) * self->num_nodes,
-              (float) ratio);
-          int next_idx =
-            get_next_idx (
-              node_indices, (int) * self->num_nodes,
-              (float) ratio);
-
-          /* calculate custom */
-          self->custom_out[i] =
-            get_custom_val_at_x (
-              *self->nodes[prev_idx][0],
-              *self->nodes[prev_idx][1],
-              *self->nodes[prev_idx][2],
-              next_idx < 0 ? 1.f :
-                *self->nodes[next_idx][0],
-              next_idx < 0 ?
-                *self->nodes[0][1] :
-                *self->nodes[next_idx][1],
-              next_idx < 0 ?
-                *self->nodes[0][2] :
-                *self->nodes[next_idx][2],
-              shifted_current_sample,
-              self->common.period_size);
-
-          /* adjust for -1 to 1 */
-          self->custom_out[i] =
-            self->custom_out[i] * 2 - 1;
+          outs[j][i] = values[j];
         }
 
-      /* invert vertically */
-      if (*self->vinvert >= 0.01f)
-        {
-#define INVERT(x) \
-  self->x##_out[i] = - self->x##_out[i]
-
-          INVERT (sine);
-          INVERT (saw);
-          INVERT (triangle);
-          INVERT (square);
-          INVERT (custom);
-
-#undef INVERT
-        }
-
-      /* if in gating mode and gate is not active,
-       * set all output to zero */
-      if (IS_GATED_MODE (self) &&
-          !(IS_GATED (self) || self->cv_gate[i] > 0.001f))
-        {
-          self->sine_out[i] = 0.f;
-          self->saw_out[i] = 0.f;
-          self->triangle_out[i] = 0.f;
-          self->square_out[i] = 0.f;
-          self->custom_out[i] = 0.f;
-        }
-
-      /* adjust range */
-#define ADJUST_RANGE(x) \
-  self->x##_out[i] = \
-    min_range + \
-    ((self->x##_out[i] + 1.f) / 2.f) * range
-
-      ADJUST_RANGE (sine);
-      ADJUST_RANGE (saw);
-      ADJUST_RANGE (triangle);
-      ADJUST_RANGE (square);
-      ADJUST_RANGE (custom);
-
-#undef ADJUST_RANGE
-
       if (is_freerunning ||
           (!is_freerunning &&
            self->common.host_pos.speed >
@@ -698,6 +1501,13 @@ run (
             self->common.period_size)
         self->common.current_sample = 0;
     }
+  write_midi_out (self, &params, n_samples);
+  write_breakpoints_out (self, n_samples);
+  if (self->ui_active)
+    {
+      write_scope (self, outs, n_samples);
+    }
+
 #if 0
   fprintf (
     stderr, "current sample %ld, "
@@ -705,6 +1515,26 @@ run (
     self->current_sample, self->period_size);
 #endif
 
+#ifdef HAVE_CYCLE_COUNTER
+  /* the UI messages are not counted */
+  update_dsp_load (
+    self, get_cycle_count () - start_cycles,
+    n_samples);
+#endif
+
+  /* set up forge to write directly to notify
+   * output port */
+  const uint32_t notify_capacity =
+    self->notify->atom.size;
+  lv2_atom_forge_set_buffer (
+    &self->common.forge, (uint8_t*) self->notify,
+    notify_capacity);
+
+  /* start a sequence in the notify output port */
+  LV2_Atom_Forge_Frame notify_frame;
+  lv2_atom_forge_sequence_head (
+    &self->common.forge, &notify_frame, 0);
+
   if (self->ui_active &&
       (self->common.period_size !=
          self->last_period_size ||
@@ -719,9 +1549,53 @@ run (
       self->first_run_with_ui = 0;
     }
 
-  /* set current sample for UI to pick up */
-  *self->sample_to_ui =
-    (float) self->common.current_sample;
+  if ((double) self->dsp_load_samples >=
+        self->common.samplerate /
+          DSP_LOAD_UPDATES_PER_SEC)
+    {
+      if (self->ui_active)
+        {
+          send_dsp_load_to_ui (self);
+        }
+      memset (
+        &self->dsp_load, 0, sizeof (DspLoad));
+      self->dsp_load_cycles = 0;
+      self->dsp_load_samples = 0;
+    }
+
+  /* send the playhead when the sample time
+   * crosses a multiple of the update interval, so
+   * the rate does not depend on the block size.
+   * the position is the one at the end of this
+   * cycle, and at most one update is sent per
+   * cycle */
+  self->playhead_time += n_samples;
+  if (self->playhead_time >=
+        self->next_playhead_time)
+    {
+      if (self->ui_active)
+        {
+          send_playhead_to_ui (self);
+          send_scope_to_ui (self);
+        }
+
+      float rate =
+        CLAMP (
+          *self->ui_update_rate,
+          MIN_UI_UPDATE_RATE, MAX_UI_UPDATE_RATE);
+      int64_t interval =
+        (int64_t)
+        (self->common.samplerate / (double) rate);
+      interval = MAX (interval, 1);
+      self->next_playhead_time =
+        (self->playhead_time / interval + 1) *
+        interval;
+    }
+
+  lv2_atom_forge_pop (
+    &self->common.forge, &notify_frame);
+
+  *self->sample_to_ui = 0.f;
 
   /* remember values */
   self->last_freq = *self->freq;
@@ -732,6 +1606,8 @@ run (
     self->common.period_size;
   self->last_samplerate =
     self->common.samplerate;
+
+  restore_denormals (fp_state);
 }
 
 static void
@@ -744,7 +1620,10 @@ static void
 cleanup (
   LV2_Handle instance)
 {
-  free (instance);
+  ZLFO * self = (ZLFO *) instance;
+  free (self->scope);
+  free (self->scope_msg);
+  free (self);
 }
 
 static const void*
@@ -34,13 +34,11 @@
 #include "lv2/atom/forge.h"
 #include "lv2/core/lv2.h"
 #include "lv2/log/log.h"
+#include "lv2/midi/midi.h"
 #include "lv2/urid/urid.h"
 #include "lv2/time/time.h"
 
-/** Min, max and default frequency. */
-#define MIN_FREQ 0.01f
-#define DEF_FREQ 1.f
-#define MAX_FREQ 60.f
+#include "zlfo_types.h"
 
 typedef struct ZLfoUris
 {
@@ -51,11 +49,13 @@ typedef struct ZLfoUris
   LV2_URID atom_Double;
   LV2_URID atom_Int;
   LV2_URID atom_Long;
+  LV2_URID atom_Vector;
   LV2_URID log_Entry;
   LV2_URID log_Error;
   LV2_URID log_Note;
   LV2_URID log_Trace;
   LV2_URID log_Warning;
+  LV2_URID midi_MidiEvent;
   LV2_URID time_Position;
   LV2_URID time_bar;
   LV2_URID time_barBeat;
@@ -79,6 +79,39 @@ typedef struct ZLfoUris
   /** Messages for UI on/off. */
   LV2_URID ui_on;
   LV2_URID ui_off;
+
+  /** Breakpoint object URI. */
+  LV2_URID breakpoint;
+
+  /* breakpoint property URIs */
+  LV2_URID breakpoint_waveform;
+  LV2_URID breakpoint_value;
+  LV2_URID breakpoint_slope;
+
+  /** DSP load statistics object URI. */
+  LV2_URID dsp_load;
+
+  /* DSP load property URIs */
+  LV2_URID dsp_load_min;
+  LV2_URID dsp_load_avg;
+  LV2_URID dsp_load_max;
+  LV2_URID dsp_load_num_blocks;
+  LV2_URID dsp_load_histogram;
+
+  /** Playhead telemetry object URI. */
+  LV2_URID playhead;
+
+  /* playhead property URIs */
+  LV2_URID playhead_current_sample;
+  LV2_URID playhead_period_size;
+  LV2_URID playhead_time;
+
+  /** Scope columns object URI. */
+  LV2_URID scope;
+
+  /* scope property URIs */
+  LV2_URID scope_samples_per_column;
+  LV2_URID scope_columns;
 } ZLfoUris;
 
 typedef enum PortIndex
@@ -87,8 +120,9 @@ typedef enum PortIndex
   ZLFO_CONTROL,
   /** Plugin to UI communication. */
   ZLFO_NOTIFY,
-  /** Plugin to UI communication of the current
-   * sample. */
+  /** Unused, kept so the port indices don't
+   * change. The current sample is sent through
+   * ZLFO_NOTIFY. */
   ZLFO_SAMPLE_TO_UI,
 
   ZLFO_CV_GATE,
@@ -166,68 +200,169 @@ typedef enum PortIndex
   ZLFO_SAW_OUT,
   ZLFO_SQUARE_OUT,
   ZLFO_CUSTOM_OUT,
+
+  /** MIDI output of the LFO as CC or pitch
+   * bend. */
+  ZLFO_MIDI_OUT,
+  ZLFO_MIDI_MODE,
+  ZLFO_MIDI_SOURCE,
+  ZLFO_MIDI_CHANNEL,
+  ZLFO_MIDI_CC,
+  ZLFO_MIDI_MAX_RATE,
+
+  /** Sparse breakpoint output of the enabled
+   * waveforms. */
+  ZLFO_BREAKPOINTS_OUT,
+  ZLFO_BREAKPOINTS_TOGGLE,
+  ZLFO_BREAKPOINTS_TOLERANCE,
+
+  /** Rate of the playhead updates sent to the
+   * UI. */
+  ZLFO_UI_UPDATE_RATE,
   NUM_ZLFO_PORTS,
 } PortIndex;
 
-typedef enum GridStep
-{
-  GRID_STEP_FULL,
-  GRID_STEP_HALF,
-  GRID_STEP_FOURTH,
-  GRID_STEP_EIGHTH,
-  GRID_STEP_SIXTEENTH,
-  GRID_STEP_THIRTY_SECOND,
-  NUM_GRID_STEPS,
-} GridStep;
-
-typedef enum SyncRate
-{
-  SYNC_1_128,
-  SYNC_1_64,
-  SYNC_1_32,
-  SYNC_1_16,
-  SYNC_1_8,
-  SYNC_1_4,
-  SYNC_1_2,
-  SYNC_1_1,
-  SYNC_2_1,
-  SYNC_4_1,
-  SYNC_8_1,
-  SYNC_16_1,
-  SYNC_32_1,
-  SYNC_64_1,
-  SYNC_128_1,
-  NUM_SYNC_RATES,
-} SyncRate;
-
-typedef enum SyncRateType
+/**
+ * What to send to the MIDI output.
+ */
+typedef enum MidiOutMode
 {
-  SYNC_TYPE_NORMAL,
-  SYNC_TYPE_DOTTED,
-  SYNC_TYPE_TRIPLET,
-  NUM_SYNC_RATE_TYPES,
-} SyncRateType;
+  MIDI_OUT_OFF,
+  MIDI_OUT_CC,
+  /** MSB on the CC and LSB on CC + 32. */
+  MIDI_OUT_CC_14BIT,
+  MIDI_OUT_PITCH_BEND,
+  NUM_MIDI_OUT_MODES,
+} MidiOutMode;
+
+/** Max breakpoints sent in a cycle. */
+#define MAX_BREAKPOINTS 256
+
+/** Space needed in the forge for each breakpoint
+ * event (an object with 3 properties). */
+#define BREAKPOINT_EVENT_SIZE \
+  (sizeof (LV2_Atom_Event) + \
+   sizeof (LV2_Atom_Object_Body) + \
+   3 * (sizeof (LV2_Atom_Property_Body) + 8))
+
+/** Size of the breakpoint output buffer needed
+ * to send MAX_BREAKPOINTS breakpoints. */
+#define BREAKPOINTS_OUT_MIN_SIZE \
+  (sizeof (LV2_Atom_Sequence) + \
+   MAX_BREAKPOINTS * BREAKPOINT_EVENT_SIZE)
+
+/** Number of buckets in the DSP load
+ * histogram. */
+#define DSP_LOAD_HISTOGRAM_SIZE 8
+
+/** Cycles per sample at the end of the first
+ * histogram bucket. Each next bucket ends at
+ * double the previous one, and the last one has
+ * no end. */
+#define DSP_LOAD_HISTOGRAM_START 16
+
+/** Number of DSP load updates sent to the UI per
+ * second. */
+#define DSP_LOAD_UPDATES_PER_SEC 4
+
+/** Default number of playhead updates sent to the
+ * UI per second. */
+#define DEF_UI_UPDATE_RATE 60.f
+
+/** Range of the UI update rate port. */
+#define MIN_UI_UPDATE_RATE 1.f
+#define MAX_UI_UPDATE_RATE 120.f
+
+/** Number of columns of the scope trace in the
+ * UI. A period of the LFO spans at most this many
+ * columns. */
+#define SCOPE_SIZE 256
+
+/** Number of columns the DSP keeps until they are
+ * sent to the UI. At most one less than this is
+ * sent per update. */
+#define SCOPE_RING_SIZE 32
+
+/** Space needed in the forge for an object
+ * property with a value of up to 8 bytes. */
+#define NOTIFY_PROPERTY_SIZE \
+  (sizeof (LV2_Atom_Property_Body) + 8)
+
+/** Space needed in the forge for an object
+ * property with a vector of @p n elements of
+ * @p size bytes. */
+#define NOTIFY_VECTOR_PROPERTY_SIZE(n,size) \
+  (sizeof (LV2_Atom_Property_Body) + \
+   sizeof (LV2_Atom_Vector_Body) + \
+   (((size_t) (n) * (size) + 7) & ~(size_t) 7))
+
+/** Space needed in the forge for an event with an
+ * object of @p n_props properties, plus the
+ * space of its vector properties if any. */
+#define NOTIFY_EVENT_SIZE(n_props) \
+  (sizeof (LV2_Atom_Event) + \
+   sizeof (LV2_Atom_Object_Body) + \
+   (n_props) * NOTIFY_PROPERTY_SIZE)
+
+/** Space needed for each message sent to the
+ * UI. */
+#define UI_STATE_EVENT_SIZE NOTIFY_EVENT_SIZE (5)
+#define POSITION_EVENT_SIZE NOTIFY_EVENT_SIZE (4)
+#define DSP_LOAD_EVENT_SIZE \
+  (NOTIFY_EVENT_SIZE (4) + \
+   NOTIFY_VECTOR_PROPERTY_SIZE ( \
+     DSP_LOAD_HISTOGRAM_SIZE, sizeof (int32_t)))
+#define PLAYHEAD_EVENT_SIZE NOTIFY_EVENT_SIZE (3)
+#define SCOPE_EVENT_SIZE(num_columns) \
+  (NOTIFY_EVENT_SIZE (1) + \
+   NOTIFY_VECTOR_PROPERTY_SIZE ( \
+     (num_columns) * NUM_WAVEFORMS * 2, \
+     sizeof (float)))
+
+/** Size of the notify output buffer needed to
+ * send every message in the same cycle. */
+#define NOTIFY_MIN_SIZE \
+  (sizeof (LV2_Atom_Sequence) + \
+   UI_STATE_EVENT_SIZE + POSITION_EVENT_SIZE + \
+   DSP_LOAD_EVENT_SIZE + PLAYHEAD_EVENT_SIZE + \
+   SCOPE_EVENT_SIZE (SCOPE_RING_SIZE - 1))
 
-typedef enum CurveAlgorithm
+/**
+ * Position of the LFO, sent to the UI so it can
+ * draw the playhead.
+ *
+ * The values are 64-bit so they stay exact for
+ * long synced periods, unlike a float port.
+ */
+typedef struct Playhead
 {
-  CURVE_ALGORITHM_EXPONENT,
-  CURVE_ALGORITHM_SUPERELLIPSE,
-} CurveAlgorithm;
+  /** Sample index in the period. */
+  int64_t       current_sample;
 
-typedef struct HostPosition
-{
-  float     bpm;
+  /** Size of the period in samples. */
+  int64_t       period_size;
 
-  /** Current global frame. */
-  long      frame;
+  /** Number of samples processed since the
+   * plugin was instantiated, at the end of the
+   * cycle the position was taken at. */
+  int64_t       time;
+} Playhead;
 
-  /** Transport speed (0.0 is stopped, 1.0 is
-   * normal playback, -1.0 is reverse playback,
-   * etc.). */
-  float     speed;
+/**
+ * Statistics about the cost of run(), in CPU
+ * cycles (or nanoseconds when there is no cycle
+ * counter) per sample, over a number of blocks.
+ */
+typedef struct DspLoad
+{
+  float         min;
+  float         avg;
+  float         max;
+  int           num_blocks;
 
-  int       beat_unit;
-} HostPosition;
+  /** Number of blocks in each bucket. */
+  int           histogram[DSP_LOAD_HISTOGRAM_SIZE];
+} DspLoad;
 
 /**
  * Group of variables needed by both the DSP and
@@ -273,12 +408,6 @@ typedef struct ZLfoCommon
   float         saw_multiplier;
 } ZLfoCommon;
 
-typedef struct NodeIndexElement
-{
-  int   index;
-  float pos;
-} NodeIndexElement;
-
 static inline void
 map_uris (
   LV2_URID_Map* map,
@@ -294,12 +423,14 @@ map_uris (
   MAP (atom_Double, LV2_ATOM__Double);
   MAP (atom_Int, LV2_ATOM__Int);
   MAP (atom_Long, LV2_ATOM__Long);
+  MAP (atom_Vector, LV2_ATOM__Vector);
   MAP (atom_eventTransfer, LV2_ATOM__eventTransfer);
   MAP (log_Entry, LV2_LOG__Entry);
   MAP (log_Error, LV2_LOG__Error);
   MAP (log_Note, LV2_LOG__Note);
   MAP (log_Trace, LV2_LOG__Trace);
   MAP (log_Warning, LV2_LOG__Warning);
+  MAP (midi_MidiEvent, LV2_MIDI__MidiEvent);
   MAP (time_Position, LV2_TIME__Position);
   MAP (time_bar, LV2_TIME__bar);
   MAP (time_barBeat, LV2_TIME__barBeat);
@@ -328,6 +459,39 @@ map_uris (
   MAP (
     ui_state_samplerate,
     LFO_URI "#ui_state_samplerate");
+  MAP (breakpoint, LFO_URI "#breakpoint");
+  MAP (
+    breakpoint_waveform,
+    LFO_URI "#breakpoint_waveform");
+  MAP (
+    breakpoint_value,
+    LFO_URI "#breakpoint_value");
+  MAP (
+    breakpoint_slope,
+    LFO_URI "#breakpoint_slope");
+  MAP (dsp_load, LFO_URI "#dsp_load");
+  MAP (dsp_load_min, LFO_URI "#dsp_load_min");
+  MAP (dsp_load_avg, LFO_URI "#dsp_load_avg");
+  MAP (dsp_load_max, LFO_URI "#dsp_load_max");
+  MAP (
+    dsp_load_num_blocks,
+    LFO_URI "#dsp_load_num_blocks");
+  MAP (
+    dsp_load_histogram,
+    LFO_URI "#dsp_load_histogram");
+  MAP (playhead, LFO_URI "#playhead");
+  MAP (
+    playhead_current_sample,
+    LFO_URI "#playhead_current_sample");
+  MAP (
+    playhead_period_size,
+    LFO_URI "#playhead_period_size");
+  MAP (playhead_time, LFO_URI "#playhead_time");
+  MAP (scope, LFO_URI "#scope");
+  MAP (
+    scope_samples_per_column,
+    LFO_URI "#scope_samples_per_column");
+  MAP (scope_columns, LFO_URI "#scope_columns");
 }
 
 /**
@@ -381,6 +545,145 @@ update_position_from_atom_obj (
     }
 }
 
+/**
+ * Updates the DspLoad with the given dsp_load
+ * atom object.
+ */
+static inline void
+update_dsp_load_from_atom_obj (
+  DspLoad *               load,
+  ZLfoUris *              uris,
+  const LV2_Atom_Object * obj)
+{
+  const LV2_Atom
+    * min = NULL,
+    * avg = NULL,
+    * max = NULL,
+    * num_blocks = NULL,
+    * histogram = NULL;
+  lv2_atom_object_get (
+    obj, uris->dsp_load_min, &min,
+    uris->dsp_load_avg, &avg,
+    uris->dsp_load_max, &max,
+    uris->dsp_load_num_blocks, &num_blocks,
+    uris->dsp_load_histogram, &histogram, NULL);
+  if (min && min->type == uris->atom_Float)
+    load->min = ((const LV2_Atom_Float *) min)->body;
+  if (avg && avg->type == uris->atom_Float)
+    load->avg = ((const LV2_Atom_Float *) avg)->body;
+  if (max && max->type == uris->atom_Float)
+    load->max = ((const LV2_Atom_Float *) max)->body;
+  if (num_blocks &&
+      num_blocks->type == uris->atom_Int)
+    {
+      load->num_blocks =
+        ((const LV2_Atom_Int *) num_blocks)->body;
+    }
+  if (histogram &&
+      histogram->type == uris->atom_Vector &&
+      histogram->size >= sizeof (LV2_Atom_Vector_Body))
+    {
+      const LV2_Atom_Vector * vec =
+        (const LV2_Atom_Vector *) histogram;
+      uint32_t n_elems =
+        (vec->atom.size -
+         (uint32_t) sizeof (LV2_Atom_Vector_Body)) /
+        (uint32_t) sizeof (int32_t);
+      if (vec->body.child_type == uris->atom_Int &&
+          vec->body.child_size == sizeof (int32_t) &&
+          n_elems == DSP_LOAD_HISTOGRAM_SIZE)
+        {
+          memcpy (
+            load->histogram, vec + 1,
+            sizeof (load->histogram));
+        }
+    }
+}
+
+/**
+ * Updates the Playhead with the given playhead
+ * atom object.
+ *
+ * @return Non-zero if the object is missing a
+ *   property.
+ */
+static inline int
+update_playhead_from_atom_obj (
+  Playhead *              playhead,
+  ZLfoUris *              uris,
+  const LV2_Atom_Object * obj)
+{
+  const LV2_Atom
+    * current_sample = NULL,
+    * period_size = NULL,
+    * time = NULL;
+  lv2_atom_object_get (
+    obj,
+    uris->playhead_current_sample, &current_sample,
+    uris->playhead_period_size, &period_size,
+    uris->playhead_time, &time, NULL);
+  if (!current_sample ||
+      current_sample->type != uris->atom_Long ||
+      !period_size ||
+      period_size->type != uris->atom_Long ||
+      !time || time->type != uris->atom_Long)
+    {
+      return -1;
+    }
+
+  playhead->current_sample =
+    ((const LV2_Atom_Long *) current_sample)->body;
+  playhead->period_size =
+    ((const LV2_Atom_Long *) period_size)->body;
+  playhead->time =
+    ((const LV2_Atom_Long *) time)->body;
+
+  return 0;
+}
+
+/**
+ * Gets the columns in the given scope atom object.
+ *
+ * Each column has the min and max of each
+ * waveform, as NUM_WAVEFORMS pairs of floats.
+ *
+ * @param columns Position to save a pointer to the
+ *   first column in the object in.
+ * @return The number of columns, or -1 if the
+ *   object is invalid.
+ */
+static inline int
+get_scope_columns_from_atom_obj (
+  ZLfoUris *              uris,
+  const LV2_Atom_Object * obj,
+  const float **          columns)
+{
+  const LV2_Atom * vec_atom = NULL;
+  lv2_atom_object_get (
+    obj, uris->scope_columns, &vec_atom, NULL);
+  if (!vec_atom ||
+      vec_atom->type != uris->atom_Vector ||
+      vec_atom->size < sizeof (LV2_Atom_Vector_Body))
+    return -1;
+
+  const LV2_Atom_Vector * vec =
+    (const LV2_Atom_Vector *) vec_atom;
+  if (vec->body.child_type != uris->atom_Float ||
+      vec->body.child_size != sizeof (float))
+    return -1;
+
+  uint32_t n_elems =
+    (vec->atom.size -
+     (uint32_t) sizeof (LV2_Atom_Vector_Body)) /
+    (uint32_t) sizeof (float);
+  if (n_elems % (NUM_WAVEFORMS * 2) != 0)
+    return -1;
+
+  *columns = (const float *) (vec + 1);
+
+  return (int) (n_elems / (NUM_WAVEFORMS * 2));
+}
+
 /**
  * Logs an error.
  */
@@ -411,48 +714,4 @@ log_error (
   va_end (args);
 }
 
-/**
- * Gets the val of the custom graph at x, with
- * x_size corresponding to the period size.
- */
-static inline float
-get_custom_val_at_x (
-  const float        prev_node_pos,
-  const float        prev_node_val,
-  const float        prev_node_curve,
-  const float        next_node_pos,
-  const float        next_node_val,
-  const float        next_node_curve,
-  float              x,
-  float              x_size)
-{
-  if (next_node_pos - prev_node_pos < 0.00000001f)
-    return prev_node_val;
-
-  float xratio = x / x_size;
-
-  float range = next_node_pos - prev_node_pos;
-
-  /* x relative to the start of the previous node */
-  float rel_x = xratio - prev_node_pos;
-
-  /* get slope */
-  float m =
-    (next_node_val - prev_node_val) / range;
-
-  return m * (rel_x) + prev_node_val;
-}
-
-#ifndef MAX
-# define MAX(x,y) (x > y ? x : y)
-#endif
-
-#ifndef MIN
-# define MIN(x,y) (x < y ? x : y)
-#endif
-
-#ifndef CLAMP
-# define CLAMP(x, low, high)  (((x) > (high)) ? (high) : (((x) < (low)) ? (low) : (x)))
-#endif
-
 #endif
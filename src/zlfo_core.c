@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlfo_core.h"
+#include "zlfo_math.h"
+#include "zlfo_types.h"
+
+/* the outputs are passed to render_frames() as
+ * they are */
+_Static_assert (
+  ZLFO_WAVEFORM_SINE == (int) WAVEFORM_SINE &&
+  ZLFO_WAVEFORM_TRIANGLE == (int) WAVEFORM_TRIANGLE &&
+  ZLFO_WAVEFORM_SAW == (int) WAVEFORM_SAW &&
+  ZLFO_WAVEFORM_SQUARE == (int) WAVEFORM_SQUARE &&
+  ZLFO_WAVEFORM_CUSTOM == (int) WAVEFORM_CUSTOM &&
+  ZLFO_NUM_WAVEFORMS == (int) NUM_WAVEFORMS,
+  "waveforms do not match");
+
+struct ZLfoEngine
+{
+  float         samplerate;
+
+  /** Parameter values, indexed by ZLfoParam. */
+  float         values[NUM_ZLFO_PARAMS];
+
+  /** Custom waveform nodes. */
+  float         nodes[16][3];
+
+  /** Snapshot used for rendering. */
+  LfoParams     params;
+
+  /** Whether the snapshot needs to be
+   * recalculated before rendering. */
+  int           params_changed;
+
+  /** Next frame to render. */
+  uint64_t      frame;
+};
+
+static void
+update_params (
+  ZLfoEngine * self)
+{
+  LfoParams * params = &self->params;
+  float * values = self->values;
+
+  HostPosition host_pos;
+  memset (&host_pos, 0, sizeof (host_pos));
+  host_pos.bpm = values[ZLFO_PARAM_BPM];
+  host_pos.beat_unit =
+    (int) values[ZLFO_PARAM_BEAT_UNIT];
+  host_pos.speed = 1.f;
+
+  set_params_timing (
+    params,
+    values[ZLFO_PARAM_FREE_RUNNING] > 0.001f,
+    values[ZLFO_PARAM_FREQ], &host_pos,
+    (SyncRate) values[ZLFO_PARAM_SYNC_RATE],
+    (SyncRateType)
+    values[ZLFO_PARAM_SYNC_RATE_TYPE],
+    self->samplerate);
+  params->hinvert =
+    values[ZLFO_PARAM_HINVERT] >= 0.01f;
+  params->vinvert =
+    values[ZLFO_PARAM_VINVERT] >= 0.01f;
+  params->step_mode =
+    values[ZLFO_PARAM_STEP_MODE] > 0.001f;
+  params->gated_mode =
+    values[ZLFO_PARAM_GATED_MODE] > 0.001f;
+  params->gate = values[ZLFO_PARAM_GATE] > 0.001f;
+  params->shift = values[ZLFO_PARAM_SHIFT];
+  params->range_min = values[ZLFO_PARAM_RANGE_MIN];
+  params->range_max = values[ZLFO_PARAM_RANGE_MAX];
+  params->grid_step =
+    (GridStep) values[ZLFO_PARAM_GRID_STEP];
+  params->num_nodes =
+    CLAMP ((int) values[ZLFO_PARAM_NUM_NODES], 1, 16);
+  memcpy (
+    params->nodes, self->nodes,
+    sizeof (self->nodes));
+  prepare_params (params);
+
+  self->params_changed = 0;
+}
+
+ZLfoEngine *
+zlfo_engine_new (
+  double samplerate)
+{
+  if (samplerate <= 0.0)
+    return NULL;
+
+  ZLfoEngine * self =
+    calloc (1, sizeof (ZLfoEngine));
+  if (!self)
+    return NULL;
+
+  self->samplerate = (float) samplerate;
+
+  zlfo_tables_init ();
+
+  /* same as the plugin defaults */
+  float * values = self->values;
+  values[ZLFO_PARAM_FREQ] = DEF_FREQ;
+  values[ZLFO_PARAM_FREE_RUNNING] = 1.f;
+  values[ZLFO_PARAM_SYNC_RATE] = SYNC_1_4;
+  values[ZLFO_PARAM_SYNC_RATE_TYPE] =
+    SYNC_TYPE_NORMAL;
+  values[ZLFO_PARAM_SHIFT] = 0.5f;
+  values[ZLFO_PARAM_RANGE_MIN] = -1.f;
+  values[ZLFO_PARAM_RANGE_MAX] = 1.f;
+  values[ZLFO_PARAM_GRID_STEP] = GRID_STEP_EIGHTH;
+  values[ZLFO_PARAM_NUM_NODES] = 2.f;
+  values[ZLFO_PARAM_BPM] = 120.f;
+  values[ZLFO_PARAM_BEAT_UNIT] = 4.f;
+  self->nodes[0][1] = 1.f;
+  self->nodes[1][0] = 1.f;
+
+  self->params_changed = 1;
+
+  return self;
+}
+
+void
+zlfo_engine_set_param (
+  ZLfoEngine * self,
+  ZLfoParam    param,
+  float        val)
+{
+  if ((int) param < 0 || param >= NUM_ZLFO_PARAMS)
+    return;
+
+  self->values[param] = val;
+  self->params_changed = 1;
+}
+
+float
+zlfo_engine_get_param (
+  ZLfoEngine * self,
+  ZLfoParam    param)
+{
+  if ((int) param < 0 || param >= NUM_ZLFO_PARAMS)
+    return 0.f;
+
+  return self->values[param];
+}
+
+void
+zlfo_engine_set_node (
+  ZLfoEngine * self,
+  int          idx,
+  float        pos,
+  float        val,
+  float        curve)
+{
+  if (idx < 0 || idx >= 16)
+    return;
+
+  self->nodes[idx][0] = pos;
+  self->nodes[idx][1] = val;
+  self->nodes[idx][2] = curve;
+  self->params_changed = 1;
+}
+
+void
+zlfo_engine_seek (
+  ZLfoEngine * self,
+  uint64_t     frame)
+{
+  self->frame = frame;
+}
+
+uint64_t
+zlfo_engine_get_position (
+  ZLfoEngine * self)
+{
+  return self->frame;
+}
+
+void
+zlfo_engine_render (
+  ZLfoEngine * self,
+  uint32_t     n_frames,
+  float *      outs[ZLFO_NUM_WAVEFORMS])
+{
+  if (self->params_changed)
+    update_params (self);
+
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      self->params.enabled[i] = outs[i] != NULL;
+    }
+
+  uint64_t fp_state = disable_denormals ();
+  render_frames (
+    &self->params, self->frame, n_frames, outs);
+  restore_denormals (fp_state);
+
+  self->frame += n_frames;
+}
+
+void
+zlfo_engine_free (
+  ZLfoEngine * self)
+{
+  free (self);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * LFO engine that can be embedded without LV2.
+ *
+ * The engine keeps its own parameters and
+ * position, and renders any waveform into
+ * caller-provided buffers.
+ *
+ * This header only depends on the standard
+ * library, so it can be installed on its own.
+ */
+
+#ifndef __Z_LFO_CORE_H__
+#define __Z_LFO_CORE_H__
+
+#include <stdint.h>
+
+/**
+ * Waveforms the engine renders.
+ */
+typedef enum ZLfoWaveform
+{
+  ZLFO_WAVEFORM_SINE,
+  ZLFO_WAVEFORM_TRIANGLE,
+  ZLFO_WAVEFORM_SAW,
+  ZLFO_WAVEFORM_SQUARE,
+  ZLFO_WAVEFORM_CUSTOM,
+  ZLFO_NUM_WAVEFORMS,
+} ZLfoWaveform;
+
+/**
+ * Engine parameters.
+ *
+ * These have the same meaning and defaults as
+ * the corresponding plugin controls.
+ */
+typedef enum ZLfoParam
+{
+  ZLFO_PARAM_FREQ,
+  ZLFO_PARAM_FREE_RUNNING,
+  /** Index of the rate, from 1/128 to 128/1, as
+   * in the sync_rate control. */
+  ZLFO_PARAM_SYNC_RATE,
+  /** Normal, dotted or triplet, as in the
+   * sync_rate_type control. */
+  ZLFO_PARAM_SYNC_RATE_TYPE,
+  ZLFO_PARAM_SHIFT,
+  ZLFO_PARAM_RANGE_MIN,
+  ZLFO_PARAM_RANGE_MAX,
+  ZLFO_PARAM_STEP_MODE,
+  /** Index of the grid step, from full to 1/32,
+   * as in the grid_step control. */
+  ZLFO_PARAM_GRID_STEP,
+  ZLFO_PARAM_HINVERT,
+  ZLFO_PARAM_VINVERT,
+  ZLFO_PARAM_GATED_MODE,
+  ZLFO_PARAM_GATE,
+  ZLFO_PARAM_NUM_NODES,
+
+  /** Tempo, used when not free-running. */
+  ZLFO_PARAM_BPM,
+  ZLFO_PARAM_BEAT_UNIT,
+  NUM_ZLFO_PARAMS,
+} ZLfoParam;
+
+typedef struct ZLfoEngine ZLfoEngine;
+
+/**
+ * Creates an engine with the default parameters
+ * at position 0.
+ *
+ * @return The engine, or NULL if failed.
+ */
+ZLfoEngine *
+zlfo_engine_new (
+  double samplerate);
+
+void
+zlfo_engine_set_param (
+  ZLfoEngine * self,
+  ZLfoParam    param,
+  float        val);
+
+float
+zlfo_engine_get_param (
+  ZLfoEngine * self,
+  ZLfoParam    param);
+
+/**
+ * Sets the position (0 to 1), value (0 to 1) and
+ * curve of the custom waveform node at @p idx.
+ */
+void
+zlfo_engine_set_node (
+  ZLfoEngine * self,
+  int          idx,
+  float        pos,
+  float        val,
+  float        curve);
+
+/**
+ * Moves the engine to the given absolute frame.
+ *
+ * Frame 0 is the start of a period.
+ */
+void
+zlfo_engine_seek (
+  ZLfoEngine * self,
+  uint64_t     frame);
+
+/**
+ * Returns the absolute frame the next render will
+ * start from.
+ */
+uint64_t
+zlfo_engine_get_position (
+  ZLfoEngine * self);
+
+/**
+ * Renders @p n_frames starting at the current
+ * position and advances the position.
+ *
+ * @param outs Buffers to render to, indexed by
+ *   ZLfoWaveform. Waveforms with a NULL buffer
+ *   are not computed.
+ */
+void
+zlfo_engine_render (
+  ZLfoEngine * self,
+  uint32_t     n_frames,
+  float *      outs[ZLFO_NUM_WAVEFORMS]);
+
+void
+zlfo_engine_free (
+  ZLfoEngine * self);
+
+#endif
@@ -30,14 +30,127 @@
 
 #include <float.h>
 #include <math.h>
+#include <stdint.h>
 
-#include "zlfo_common.h"
+#if defined (__SSE__)
+#include <xmmintrin.h>
+#endif
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "zlfo_tables.h"
+#include "zlfo_types.h"
 
 static const float PI = (float) M_PI;
 
 #define math_doubles_equal(a,b) \
   (a > b ? a - b < DBL_EPSILON : b - a < DBL_EPSILON)
 
+#if defined (__SSE__)
+/** MXCSR flush-to-zero (bit 15) and
+ * denormals-are-zero (bit 6) flags. */
+#define FP_STATE_NO_DENORMALS 0x8040
+#elif defined (__aarch64__)
+/** FPCR flush-to-zero flag (bit 24). */
+#define FP_STATE_NO_DENORMALS (1ULL << 24)
+#endif
+
+/**
+ * Makes the FPU of the calling thread flush
+ * subnormal results and inputs to zero.
+ *
+ * Subnormals appear when scaling to very small
+ * ranges and they are extremely slow to process
+ * on x86.
+ *
+ * @return The previous floating point state, to be
+ *   passed to restore_denormals().
+ */
+static inline uint64_t
+disable_denormals (void)
+{
+#if defined (__SSE__)
+  uint64_t state = _mm_getcsr ();
+  if ((state & FP_STATE_NO_DENORMALS) !=
+        FP_STATE_NO_DENORMALS)
+    {
+      _mm_setcsr (
+        (unsigned int)
+        (state | FP_STATE_NO_DENORMALS));
+    }
+  return state;
+#elif defined (__aarch64__)
+  uint64_t state;
+  __asm__ __volatile__ (
+    "mrs %0, fpcr" : "=r" (state));
+  if (!(state & FP_STATE_NO_DENORMALS))
+    {
+      __asm__ __volatile__ (
+        "msr fpcr, %0" : :
+        "r" (state | FP_STATE_NO_DENORMALS));
+    }
+  return state;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Restores the floating point state returned by
+ * disable_denormals().
+ */
+static inline void
+restore_denormals (
+  uint64_t state)
+{
+#if defined (__SSE__)
+  if ((state & FP_STATE_NO_DENORMALS) !=
+        FP_STATE_NO_DENORMALS)
+    {
+      _mm_setcsr ((unsigned int) state);
+    }
+#elif defined (__aarch64__)
+  if (!(state & FP_STATE_NO_DENORMALS))
+    {
+      __asm__ __volatile__ (
+        "msr fpcr, %0" : : "r" (state));
+    }
+#else
+  (void) state;
+#endif
+}
+
+#if defined (__x86_64__) || defined (__i386__) || \
+  defined (__aarch64__)
+/** Defined if get_cycle_count() is available.
+ * Other platforms would need a clock call, which
+ * may be a syscall, so they don't measure the DSP
+ * load. */
+#define HAVE_CYCLE_COUNTER 1
+
+/**
+ * Returns a cheap timestamp for measuring short
+ * durations.
+ *
+ * This is the CPU cycle counter on x86 and the
+ * virtual counter on aarch64, read without a
+ * syscall.
+ */
+static inline uint64_t
+get_cycle_count (void)
+{
+#if defined (__aarch64__)
+  uint64_t val;
+  __asm__ __volatile__ (
+    "mrs %0, cntvct_el0" : "=r" (val));
+  return val;
+#else
+  return __rdtsc ();
+#endif
+}
+#endif
+
 static inline float
 sync_rate_to_float (
   SyncRate     rate,
@@ -213,16 +326,11 @@ get_effective_freq (
   float          sync_rate_float)
 {
   /* if beat_unit is 0 that means we don't know the
-   * time info yet */
+   * time info yet, so fall back to the free
+   * running frequency (this is called from the
+   * audio thread, so don't warn here) */
   if (freerunning || host_pos->beat_unit == 0)
     {
-      if (!freerunning && host_pos->beat_unit == 0)
-        {
-          fprintf (
-            stderr,
-            "Host did not send time info. Beat "
-            "unit is unknown.\n");
-        }
       return freq;
     }
   else /* synced */
@@ -248,13 +356,6 @@ get_period_size (
    * time info yet */
   if (freerunning || host_pos->beat_unit == 0)
     {
-      if (!freerunning && host_pos->beat_unit == 0)
-        {
-          fprintf (
-            stderr,
-            "Host did not send time info. Beat "
-            "unit is unknown.\n");
-        }
       return
         (uint32_t) (samplerate / effective_freq);
     }
@@ -281,10 +382,6 @@ get_current_sample (
     {
       /* if beat_unit is 0 that means we don't
        * know the time info yet */
-      fprintf (
-        stderr,
-        "Host did not send time info. Beat "
-        "unit is unknown.\n");
       return 0;
     }
   else /* synced */
@@ -293,6 +390,55 @@ get_current_sample (
     }
 }
 
+/**
+ * Extends the range in @p min and @p max with the
+ * values in the array.
+ *
+ * Uses SSE when available, 4 values at a time.
+ */
+static inline void
+float_array_get_min_max (
+  const float * arr,
+  size_t        size,
+  float *       min,
+  float *       max)
+{
+  size_t i = 0;
+  float mn = *min;
+  float mx = *max;
+
+#if defined (__SSE__)
+  if (size >= 4)
+    {
+      __m128 vmin = _mm_set1_ps (mn);
+      __m128 vmax = _mm_set1_ps (mx);
+      for (; i + 4 <= size; i += 4)
+        {
+          __m128 v = _mm_loadu_ps (&arr[i]);
+          vmin = _mm_min_ps (vmin, v);
+          vmax = _mm_max_ps (vmax, v);
+        }
+      float mins[4], maxs[4];
+      _mm_storeu_ps (mins, vmin);
+      _mm_storeu_ps (maxs, vmax);
+      for (int j = 0; j < 4; j++)
+        {
+          mn = mins[j] < mn ? mins[j] : mn;
+          mx = maxs[j] > mx ? maxs[j] : mx;
+        }
+    }
+#endif
+
+  for (; i < size; i++)
+    {
+      mn = arr[i] < mn ? arr[i] : mn;
+      mx = arr[i] > mx ? arr[i] : mx;
+    }
+
+  *min = mn;
+  *max = mx;
+}
+
 static inline int
 float_array_contains_nonzero (
   const float * arr,
@@ -443,9 +589,9 @@ invert_and_shift_xval (
  */
 static inline int
 get_next_idx (
-  NodeIndexElement * elements,
-  int                num_nodes,
-  float              ratio)
+  const NodeIndexElement * elements,
+  int                      num_nodes,
+  float                    ratio)
 {
   float max_pos = 2.f;
   int max_idx = 0;
@@ -471,9 +617,9 @@ get_next_idx (
 
 static inline int
 get_prev_idx (
-  NodeIndexElement * elements,
-  int                num_nodes,
-  float              ratio)
+  const NodeIndexElement * elements,
+  int                      num_nodes,
+  float                    ratio)
 {
   float min_pos = -1.f;
   int min_idx = 0;
@@ -490,14 +636,14 @@ get_prev_idx (
   return min_idx;
 }
 
-static int
-pos_cmp (const void * a, const void * b)
-{
-  float pos_a = (*(NodeIndexElement*)a).pos;
-  float pos_b = (*(NodeIndexElement*)b).pos;
-  return pos_a > pos_b;
-}
-
+/**
+ * Sorts the node indices by position.
+ *
+ * This is a stable insertion sort instead of
+ * qsort(), which may allocate, so that it can be
+ * called from the audio thread. There are at most
+ * 16 nodes so it is not slower in practice.
+ */
 static inline void
 sort_node_indices_by_pos (
   float              nodes[16][3],
@@ -507,13 +653,313 @@ sort_node_indices_by_pos (
   for (int i = 0; i < num_nodes; i++)
     {
       /* set index and position */
-      elements[i].index = i;
-      elements[i].pos = nodes[i][0];
+      NodeIndexElement el = {
+        .index = i,
+        .pos = nodes[i][0],
+      };
+
+      /* shift the bigger elements to the right */
+      int j = i;
+      while (j > 0 && elements[j - 1].pos > el.pos)
+        {
+          elements[j] = elements[j - 1];
+          j--;
+        }
+      elements[j] = el;
     }
+}
+
+/**
+ * Immutable snapshot of everything needed to
+ * compute the LFO outputs at any point in the
+ * period.
+ *
+ * Fill in the fields, call set_params_timing()
+ * and prepare_params(), then pass it to
+ * get_values_at_sample() or render_frames(). The
+ * snapshot is never modified by those, so it can
+ * be shared by multiple threads.
+ */
+typedef struct LfoParams
+{
+  /** Size of 1 LFO period in samples. */
+  long          period_size;
+
+  /** See recalc_vars(). */
+  float         sine_multiplier;
+
+  /** Whether each waveform is computed. Disabled
+   * waveforms output the middle of the range. */
+  int           enabled[NUM_WAVEFORMS];
+
+  int           hinvert;
+  int           vinvert;
+  int           step_mode;
+  int           gated_mode;
+  int           gate;
+
+  float         shift;
+  float         range_min;
+  float         range_max;
+  GridStep      grid_step;
 
-  qsort (
-    elements, (size_t) num_nodes,
-    sizeof (NodeIndexElement), pos_cmp);
+  int           num_nodes;
+  float         nodes[16][3];
+
+  /* the fields below are set by prepare_params() */
+
+  float         min_range;
+  float         range;
+  long          step_frames;
+  NodeIndexElement node_indices[16];
+} LfoParams;
+
+/**
+ * Sets the period size and sine multiplier for
+ * the given frequency or sync rate.
+ */
+static inline void
+set_params_timing (
+  LfoParams *    params,
+  int            freerunning,
+  float          freq,
+  HostPosition * host_pos,
+  SyncRate       sync_rate,
+  SyncRateType   sync_rate_type,
+  float          samplerate)
+{
+  float sync_rate_float =
+    sync_rate_to_float (sync_rate, sync_rate_type);
+  float effective_freq =
+    get_effective_freq (
+      freerunning, freq, host_pos, sync_rate_float);
+  float saw_multiplier;
+  recalc_vars (
+    freerunning, &params->sine_multiplier,
+    &saw_multiplier, &params->period_size, NULL,
+    host_pos, effective_freq, sync_rate_float,
+    samplerate);
+}
+
+/**
+ * Calculates the derived fields of the snapshot,
+ * except the node order.
+ *
+ * For callers that keep node_indices from a
+ * previous snapshot with the same nodes.
+ */
+static inline void
+prepare_params_except_nodes (
+  LfoParams * params)
+{
+  params->min_range =
+    MIN (params->range_max, params->range_min);
+  params->range =
+    MAX (params->range_max, params->range_min) -
+    params->min_range;
+  params->step_frames =
+    (long)
+    ((float) params->period_size /
+     (float)
+     grid_step_to_divisor (params->grid_step));
+}
+
+/**
+ * Calculates the derived fields of the snapshot.
+ *
+ * Must be called after any other field changes.
+ */
+static inline void
+prepare_params (
+  LfoParams * params)
+{
+  prepare_params_except_nodes (params);
+  sort_node_indices_by_pos (
+    params->nodes, params->node_indices,
+    params->num_nodes);
+}
+
+/**
+ * Computes the value of each waveform at the given
+ * sample in the period.
+ *
+ * zlfo_tables_init() must have been called.
+ *
+ * @param current_sample Sample index in the
+ *   period, before inverting and shifting.
+ * @param gate_open Whether the gate is open, only
+ *   used in gated mode.
+ * @param values Array to fill in, indexed by
+ *   Waveform.
+ */
+static inline void
+get_values_at_sample (
+  const LfoParams * params,
+  long              current_sample,
+  int               gate_open,
+  float             values[NUM_WAVEFORMS])
+{
+  /* invert horizontally */
+  long shifted_current_sample =
+    invert_and_shift_xval (
+      current_sample, params->period_size,
+      params->hinvert, params->shift);
+
+  if (params->step_mode)
+    {
+      /* find closest step and set the current
+       * sample to the middle of it */
+      shifted_current_sample =
+        (shifted_current_sample /
+           params->step_frames) *
+          params->step_frames +
+        params->step_frames / 2;
+    }
+
+  float ratio =
+     (float) shifted_current_sample /
+     (float) params->period_size;
+
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      values[i] = 0.f;
+    }
+
+  if (params->enabled[WAVEFORM_SINE])
+    {
+      /* calculate sine (the multiplier is in
+       * radians per sample) */
+      values[WAVEFORM_SINE] =
+        zlfo_table_sine (
+          ((float) shifted_current_sample *
+             params->sine_multiplier) /
+          (2.f * PI));
+    }
+  if (params->enabled[WAVEFORM_SAW])
+    {
+      /* calculate saw */
+      values[WAVEFORM_SAW] =
+        (1.f - ratio) * 2.f - 1.f;
+    }
+  if (params->enabled[WAVEFORM_TRIANGLE])
+    {
+      if (ratio > 0.4999f)
+        {
+          values[WAVEFORM_TRIANGLE] =
+            (1.f - ratio) * 4.f - 1.f;
+        }
+      else
+        {
+          values[WAVEFORM_TRIANGLE] =
+            ratio * 4.f - 1.f;
+        }
+    }
+  if (params->enabled[WAVEFORM_SQUARE])
+    {
+      if (ratio > 0.4999f)
+        {
+          values[WAVEFORM_SQUARE] = - 1.f;
+        }
+      else
+        {
+          values[WAVEFORM_SQUARE] = 1.f;
+        }
+    }
+  if (params->enabled[WAVEFORM_CUSTOM])
+    {
+      int prev_idx =
+        get_prev_idx (
+          params->node_indices,
+          params->num_nodes, ratio);
+      int next_idx =
+        get_next_idx (
+          params->node_indices,
+          params->num_nodes, ratio);
+
+      /* calculate custom */
+      float val =
+        get_custom_val_at_x (
+          params->nodes[prev_idx][0],
+          params->nodes[prev_idx][1],
+          params->nodes[prev_idx][2],
+          next_idx < 0 ? 1.f :
+            params->nodes[next_idx][0],
+          next_idx < 0 ?
+            params->nodes[0][1] :
+            params->nodes[next_idx][1],
+          next_idx < 0 ?
+            params->nodes[0][2] :
+            params->nodes[next_idx][2],
+          (float) shifted_current_sample,
+          (float) params->period_size);
+
+      /* adjust for -1 to 1 */
+      values[WAVEFORM_CUSTOM] = val * 2 - 1;
+    }
+
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      /* invert vertically */
+      if (params->vinvert)
+        {
+          values[i] = - values[i];
+        }
+
+      /* if in gating mode and gate is not active,
+       * set all output to zero */
+      if (params->gated_mode && !gate_open)
+        {
+          values[i] = 0.f;
+        }
+
+      /* adjust range */
+      values[i] =
+        params->min_range +
+        ((values[i] + 1.f) / 2.f) * params->range;
+    }
+}
+
+/**
+ * Renders the given range of absolute frames
+ * without touching any state.
+ *
+ * Frame 0 is the start of a period, so any range
+ * can be rendered independently of the others,
+ * eg, in parallel or after seeking.
+ *
+ * zlfo_tables_init() must have been called.
+ *
+ * @param outs Buffers to render to, indexed by
+ *   Waveform. NULL buffers are skipped.
+ */
+static inline void
+render_frames (
+  const LfoParams * params,
+  uint64_t          start_frame,
+  uint32_t          n_frames,
+  float *           outs[NUM_WAVEFORMS])
+{
+  if (params->period_size <= 0)
+    return;
+
+  long current_sample =
+    (long)
+    (start_frame % (uint64_t) params->period_size);
+  int gate_open = params->gate;
+  float values[NUM_WAVEFORMS];
+  for (uint32_t i = 0; i < n_frames; i++)
+    {
+      get_values_at_sample (
+        params, current_sample, gate_open, values);
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          if (outs[j])
+            outs[j][i] = values[j];
+        }
+
+      if (++current_sample == params->period_size)
+        current_sample = 0;
+    }
 }
 
 #endif
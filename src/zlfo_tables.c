@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <pthread.h>
+
+#include "zlfo_tables.h"
+
+float zlfo_sine_table[SINE_TABLE_SIZE + 1];
+
+static pthread_once_t zlfo_tables_once =
+  PTHREAD_ONCE_INIT;
+
+static void
+zlfo_tables_fill (void)
+{
+  for (int i = 0; i <= SINE_TABLE_SIZE; i++)
+    {
+      zlfo_sine_table[i] =
+        (float)
+        sin (
+          (2.0 * M_PI * (double) i) /
+          (double) SINE_TABLE_SIZE);
+    }
+}
+
+void
+zlfo_tables_init (void)
+{
+  pthread_once (
+    &zlfo_tables_once, zlfo_tables_fill);
+}
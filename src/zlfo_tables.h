@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Read-only lookup tables shared by all the
+ * instances in the process.
+ *
+ * The tables are filled in once by
+ * zlfo_tables_init(), which must be called before
+ * using them (eg, in instantiate()). It is thread
+ * safe and cheap to call again, so each instance
+ * calls it on creation. The tables are never
+ * written after that, so they can be read from
+ * any thread without locking.
+ *
+ * They are defined in zlfo_tables.c, which is
+ * part of zlfo_core, so there is one copy per
+ * binary. Only the lookups are inline.
+ */
+
+#ifndef __Z_LFO_TABLES_H__
+#define __Z_LFO_TABLES_H__
+
+#include "config.h"
+
+#include <math.h>
+
+/** Number of sine values in a period. Must be a
+ * power of 2. With linear interpolation the max
+ * error is about 3e-7. */
+#define SINE_TABLE_SIZE 4096
+
+/** One period of sine, with a guard point at the
+ * end for the interpolation. */
+extern float zlfo_sine_table[SINE_TABLE_SIZE + 1];
+
+/**
+ * Fills in the tables if this is the first call
+ * in the process.
+ *
+ * Not real-time safe the first time, so don't
+ * call it from run().
+ */
+void
+zlfo_tables_init (void);
+
+/**
+ * Returns the sine at the given phase, where 0.0
+ * to 1.0 is one period.
+ *
+ * zlfo_tables_init() must have been called.
+ */
+static inline float
+zlfo_table_sine (
+  float phase)
+{
+  /* wrap to [0, 1) */
+  phase -= floorf (phase);
+
+  float idx = phase * (float) SINE_TABLE_SIZE;
+  int i = (int) idx;
+  float frac = idx - (float) i;
+
+  /* in case of rounding up to the size */
+  i &= SINE_TABLE_SIZE - 1;
+
+  return
+    zlfo_sine_table[i] +
+    frac *
+      (zlfo_sine_table[i + 1] -
+       zlfo_sine_table[i]);
+}
+
+#endif
@@ -65,6 +65,7 @@ int main (
 @prefix midi: <http://lv2plug.in/ns/ext/midi#> .\n\
 @prefix pprop: <http://lv2plug.in/ns/ext/port-props#> .\n\
 @prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n\
+@prefix rsz:  <http://lv2plug.in/ns/ext/resize-port#> .\n\
 @prefix time:  <http://lv2plug.in/ns/ext/time#> .\n\
 @prefix urid: <http://lv2plug.in/ns/ext/urid#> .\n\
 @prefix ui:   <http://lv2plug.in/ns/extensions/ui#> .\n\n");
@@ -107,6 +108,7 @@ int main (
     lv2:designation lv2:control ;\n\
     lv2:symbol \"notify\" ;\n\
     lv2:name \"Notify\" ;\n\
+    rsz:minimumSize %zu ;\n\
     rdfs:comment \"Plugin to GUI communication\" ;\n\
   ] , [\n\
     a lv2:OutputPort ,\n\
@@ -114,7 +116,7 @@ int main (
     lv2:index 2 ;\n\
     lv2:symbol \"sample_to_ui\" ;\n\
     lv2:name \"Sample to UI\" ;\n\
-    rdfs:comment \"Plugin to GUI communication\" ;\n\
+    rdfs:comment \"Unused, the position is sent through notify\" ;\n\
     lv2:default %d ;\n\
     lv2:minimum %d ;\n\
     lv2:maximum %d ;\n\
@@ -142,12 +144,20 @@ int main (
     lv2:maximum %f ;\n\
     lv2:portProperty pprop:trigger, pprop:discreteCV ;\n\
   ] , [\n",
+  NOTIFY_MIN_SIZE,
   0, 0, 30720000, 0.0, 0.0, 1.0, 0.0, 0.0, 1.0);
 
   /* write input controls */
   int index = ZLFO_GATE;
-  for (int i = index; i <= ZLFO_NUM_NODES; i++)
+  for (int i = index; i < NUM_ZLFO_PORTS; i++)
     {
+      /* skip outputs */
+      if ((i >= ZLFO_SINE_OUT &&
+           i <= ZLFO_CUSTOM_OUT) ||
+          i == ZLFO_MIDI_OUT ||
+          i == ZLFO_BREAKPOINTS_OUT)
+        continue;
+
       float def = 0.f;
       float min = 0.f;
       float max = 1.f;
@@ -292,6 +302,92 @@ int main (
           mini = 2;
           maxi = 16;
           break;
+        case ZLFO_MIDI_MODE:
+          strcpy (symbol, "midi_mode");
+          strcpy (name, "MIDI mode");
+          strcpy (
+            comment,
+            "0: off, 1: 7-bit CC, 2: 14-bit CC, "
+            "3: pitch bend");
+          type = PORT_TYPE_INT;
+          defi = MIDI_OUT_OFF;
+          mini = 0;
+          maxi = NUM_MIDI_OUT_MODES - 1;
+          break;
+        case ZLFO_MIDI_SOURCE:
+          strcpy (symbol, "midi_source");
+          strcpy (name, "MIDI source");
+          strcpy (
+            comment,
+            "Waveform to send to the MIDI output "
+            "(0: sine, 1: triangle, 2: saw, "
+            "3: square, 4: custom)");
+          type = PORT_TYPE_INT;
+          defi = WAVEFORM_CUSTOM;
+          mini = 0;
+          maxi = NUM_WAVEFORMS - 1;
+          break;
+        case ZLFO_MIDI_CHANNEL:
+          strcpy (symbol, "midi_channel");
+          strcpy (name, "MIDI channel");
+          type = PORT_TYPE_INT;
+          defi = 1;
+          mini = 1;
+          maxi = 16;
+          break;
+        case ZLFO_MIDI_CC:
+          strcpy (symbol, "midi_cc");
+          strcpy (name, "MIDI CC");
+          strcpy (
+            comment,
+            "Controller number (0-31 in 14-bit "
+            "mode)");
+          type = PORT_TYPE_INT;
+          defi = LV2_MIDI_CTL_MSB_MODWHEEL;
+          mini = 0;
+          maxi = 127;
+          break;
+        case ZLFO_MIDI_MAX_RATE:
+          strcpy (symbol, "midi_max_rate");
+          strcpy (name, "MIDI max rate");
+          strcpy (
+            comment,
+            "Maximum MIDI events per second");
+          def = 100.f;
+          min = 1.f;
+          max = 1000.f;
+          break;
+        case ZLFO_BREAKPOINTS_TOGGLE:
+          strcpy (symbol, "breakpoints_toggle");
+          strcpy (name, "Breakpoints toggle");
+          strcpy (
+            comment,
+            "Send breakpoints of the enabled "
+            "waveforms to the breakpoint output");
+          type = PORT_TYPE_TOGGLE;
+          break;
+        case ZLFO_BREAKPOINTS_TOLERANCE:
+          strcpy (symbol, "breakpoints_tolerance");
+          strcpy (name, "Breakpoint tolerance");
+          strcpy (
+            comment,
+            "Max error of linear interpolation "
+            "between breakpoints");
+          def = 0.001f;
+          min = 0.00001f;
+          max = 0.1f;
+          break;
+        case ZLFO_UI_UPDATE_RATE:
+          strcpy (symbol, "ui_update_rate");
+          strcpy (name, "UI update rate");
+          strcpy (
+            comment,
+            "Playhead updates sent to the UI per "
+            "second");
+          def = DEF_UI_UPDATE_RATE;
+          min = MIN_UI_UPDATE_RATE;
+          max = MAX_UI_UPDATE_RATE;
+          break;
         default:
           break;
         }
@@ -416,9 +512,30 @@ int main (
     lv2:index %d ;\n\
     lv2:symbol \"custom_out\" ;\n\
     lv2:name \"Custom\" ;\n\
+  ] , [\n\
+    a lv2:OutputPort ,\n\
+      atom:AtomPort ;\n\
+    atom:bufferType atom:Sequence ;\n\
+    atom:supports midi:MidiEvent ;\n\
+    lv2:index %d ;\n\
+    lv2:symbol \"midi_out\" ;\n\
+    lv2:name \"MIDI out\" ;\n\
+    rdfs:comment \"LFO as MIDI CC or pitch bend\" ;\n\
+  ] , [\n\
+    a lv2:OutputPort ,\n\
+      atom:AtomPort ;\n\
+    atom:bufferType atom:Sequence ;\n\
+    atom:supports atom:Object ;\n\
+    lv2:index %d ;\n\
+    lv2:symbol \"breakpoints_out\" ;\n\
+    lv2:name \"Breakpoints\" ;\n\
+    rsz:minimumSize %zu ;\n\
+    rdfs:comment \"Value and slope at the start of each linear segment of the enabled waveforms\" ;\n\
   ] .\n\n",
     ZLFO_SINE_OUT, ZLFO_TRIANGLE_OUT, ZLFO_SAW_OUT,
-    ZLFO_SQUARE_OUT, ZLFO_CUSTOM_OUT);
+    ZLFO_SQUARE_OUT, ZLFO_CUSTOM_OUT,
+    ZLFO_MIDI_OUT, ZLFO_BREAKPOINTS_OUT,
+    BREAKPOINTS_OUT_MIN_SIZE);
 
   /* write UI */
   fprintf (f,
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2019-2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Types shared by the DSP, the UI and the core
+ * engine.
+ *
+ * This must not depend on LV2.
+ */
+
+#ifndef __Z_LFO_TYPES_H__
+#define __Z_LFO_TYPES_H__
+
+#include "config.h"
+
+#include <stdio.h>
+
+/** Min, max and default frequency. */
+#define MIN_FREQ 0.01f
+#define DEF_FREQ 1.f
+#define MAX_FREQ 60.f
+
+typedef enum Waveform
+{
+  WAVEFORM_SINE,
+  WAVEFORM_TRIANGLE,
+  WAVEFORM_SAW,
+  WAVEFORM_SQUARE,
+  WAVEFORM_CUSTOM,
+  NUM_WAVEFORMS,
+} Waveform;
+
+typedef enum GridStep
+{
+  GRID_STEP_FULL,
+  GRID_STEP_HALF,
+  GRID_STEP_FOURTH,
+  GRID_STEP_EIGHTH,
+  GRID_STEP_SIXTEENTH,
+  GRID_STEP_THIRTY_SECOND,
+  NUM_GRID_STEPS,
+} GridStep;
+
+typedef enum SyncRate
+{
+  SYNC_1_128,
+  SYNC_1_64,
+  SYNC_1_32,
+  SYNC_1_16,
+  SYNC_1_8,
+  SYNC_1_4,
+  SYNC_1_2,
+  SYNC_1_1,
+  SYNC_2_1,
+  SYNC_4_1,
+  SYNC_8_1,
+  SYNC_16_1,
+  SYNC_32_1,
+  SYNC_64_1,
+  SYNC_128_1,
+  NUM_SYNC_RATES,
+} SyncRate;
+
+typedef enum SyncRateType
+{
+  SYNC_TYPE_NORMAL,
+  SYNC_TYPE_DOTTED,
+  SYNC_TYPE_TRIPLET,
+  NUM_SYNC_RATE_TYPES,
+} SyncRateType;
+
+typedef enum CurveAlgorithm
+{
+  CURVE_ALGORITHM_EXPONENT,
+  CURVE_ALGORITHM_SUPERELLIPSE,
+} CurveAlgorithm;
+
+typedef struct HostPosition
+{
+  float     bpm;
+
+  /** Current global frame. */
+  long      frame;
+
+  /** Transport speed (0.0 is stopped, 1.0 is
+   * normal playback, -1.0 is reverse playback,
+   * etc.). */
+  float     speed;
+
+  int       beat_unit;
+} HostPosition;
+
+typedef struct NodeIndexElement
+{
+  int   index;
+  float pos;
+} NodeIndexElement;
+
+/**
+ * Gets the val of the custom graph at x, with
+ * x_size corresponding to the period size.
+ */
+static inline float
+get_custom_val_at_x (
+  const float        prev_node_pos,
+  const float        prev_node_val,
+  const float        prev_node_curve,
+  const float        next_node_pos,
+  const float        next_node_val,
+  const float        next_node_curve,
+  float              x,
+  float              x_size)
+{
+  if (next_node_pos - prev_node_pos < 0.00000001f)
+    return prev_node_val;
+
+  float xratio = x / x_size;
+
+  float range = next_node_pos - prev_node_pos;
+
+  /* x relative to the start of the previous node */
+  float rel_x = xratio - prev_node_pos;
+
+  /* get slope */
+  float m =
+    (next_node_val - prev_node_val) / range;
+
+  return m * (rel_x) + prev_node_val;
+}
+
+#ifndef MAX
+# define MAX(x,y) (x > y ? x : y)
+#endif
+
+#ifndef MIN
+# define MIN(x,y) (x < y ? x : y)
+#endif
+
+#ifndef CLAMP
+# define CLAMP(x, low, high)  (((x) > (high)) ? (high) : (((x) < (low)) ? (low) : (x)))
+#endif
+
+#endif
@@ -88,10 +88,21 @@
 #define RANGE_STARTX 461
 
 #define GRAPH_OVERLAY_ALPHA 0.6
+#define PLAYHEAD_LINE_WIDTH 2.0
+
+/** Alpha of the scope trace. */
+#define SCOPE_ALPHA 0.5
+
+/** Height of the DSP load strip at the bottom of
+ * the mid region. */
+#define DSP_LOAD_STRIP_HEIGHT 14
 
 /** Double click interval, in seconds. */
 #define DOUBLE_CLICK_INTERVAL 0.24
 
+/** Maximum redraws per second. */
+#define MAX_FPS 60
+
 #define GET_HANDLE \
   ZLfoUi * self = (ZLfoUi *) puglGetHandle (view);
 
@@ -145,6 +156,66 @@ typedef enum DrawDataType
   DATA_TYPE_LBL,
 } DrawDataType;
 
+/**
+ * Cached layers of the mid region, from the
+ * bottom up.
+ *
+ * Each layer is only redrawn when its bit is set
+ * in ZLfoUi.dirty_layers. The playhead and the
+ * DSP load are drawn on top every time.
+ */
+typedef enum MidRegionLayer
+{
+  /** Background and grid lines. */
+  LAYER_GRID,
+
+  /** Waveforms. */
+  LAYER_WAVES,
+
+  /** Lines between the custom nodes. */
+  LAYER_NODES,
+
+  NUM_LAYERS,
+} MidRegionLayer;
+
+#define LAYER_BIT(x) (1 << (x))
+#define ALL_LAYERS (LAYER_BIT (NUM_LAYERS) - 1)
+
+/**
+ * Everything the waveform layer depends on, so
+ * that it can be drawn by the preview worker
+ * without touching the UI.
+ */
+typedef struct PreviewJob
+{
+  /** Generation of the request, to tell stale
+   * results apart. */
+  unsigned int     generation;
+
+  /** Prepared snapshot with a period of
+   * GRID_WIDTH samples. */
+  LfoParams        params;
+
+  ZtkColor         color;
+
+  /** Rectangle of the layer in the window. */
+  ZtkRect          rect;
+} PreviewJob;
+
+/**
+ * Element of a popup menu.
+ */
+typedef struct ComboBoxElement
+{
+  int           id;
+  const char *  label;
+
+  /** Popup the element was last added to. */
+  ZtkComboBox * combo;
+
+  struct ZLfoUi * zlfo_ui;
+} ComboBoxElement;
+
 typedef struct ZLfoUi
 {
   /** Port values. */
@@ -217,21 +288,90 @@ typedef struct ZLfoUi
   /** Last time the current sample was set at. */
   gint64           last_current_sample_set;
 
-  /** Whether we need to recalculate the caches. */
+  /** Whether something changed since the last
+   * draw, so the whole window must be redrawn. */
   int              has_change;
 
-  ZtkRect          last_rect;
-
-  /** Caches. */
-  float            sine_cache[GRID_WIDTH];
-  float            saw_cache[GRID_WIDTH];
+  /** Layers of the mid region that must be
+   * redrawn, as LAYER_BIT() flags. */
+  int              dirty_layers;
 
   char             bundle_path[2000];
 
   ZLfoUiTheme      ui_theme;
 
-  cairo_t *        cached_cr;
-  cairo_surface_t * cached_surface;
+  /** Cached layers, the size of the mid region. */
+  cairo_t *        layer_crs[NUM_LAYERS];
+  cairo_surface_t * layer_surfaces[NUM_LAYERS];
+
+  /** X of the playhead when it was last drawn. */
+  double           last_playhead_x;
+
+  /** Worker drawing the waveform layer, and the
+   * fields below shared with it, guarded by
+   * preview_mutex. */
+  GThread *        preview_thread;
+  GMutex           preview_mutex;
+  GCond            preview_cond;
+
+  /** Latest request, if the worker did not take
+   * it yet. Newer requests replace it. */
+  PreviewJob       preview_job;
+  int              preview_job_pending;
+
+  /** Generation of the latest request. */
+  unsigned int     preview_generation;
+
+  /** Latest layer drawn for the latest request,
+   * if the UI did not take it yet. */
+  cairo_surface_t * preview_result;
+
+  /** Whether the worker must stop. */
+  int              preview_quit;
+
+  /** Elements of the popup menus, set up once and
+   * added to a new popup every time one opens. */
+  ComboBoxElement  grid_step_elements[NUM_GRID_STEPS];
+  ComboBoxElement  sync_rate_type_elements[
+                     NUM_SYNC_RATE_TYPES];
+
+  /** Last DSP load statistics received. */
+  DspLoad          dsp_load;
+
+  /** Whether the DSP load changed since it was
+   * last drawn. */
+  int              dsp_load_changed;
+
+  /** Scope trace of the DSP outputs, with the
+   * min and max of each waveform per column. The
+   * oldest column is at scope_pos. */
+  float            scope[SCOPE_SIZE][NUM_WAVEFORMS][2];
+  int              scope_pos;
+
+  /** Number of columns received, up to
+   * SCOPE_SIZE. */
+  int              scope_num_columns;
+
+  /** Whether scope columns were received since
+   * the scope was last drawn. */
+  int              scope_changed;
+
+  /** Node values last written to or received
+   * from the DSP. */
+  float            sent_nodes[16][3];
+  int              sent_num_nodes;
+
+  /** Whether the nodes were edited since they
+   * were last written. */
+  int              nodes_edited;
+
+  /** Whether the window is shown. Hosts that
+   * embed the UI never hide it. */
+  int              visible;
+
+  /** Last time redraws were posted at, in
+   * microseconds. */
+  gint64           last_redraw_time;
 
   ZtkApp *         app;
 } ZLfoUi;
@@ -255,6 +395,19 @@ typedef struct DrawData
        sizeof (float), 0, &fval); \
   }
 
+/**
+ * Marks the window for a full redraw and the
+ * given layers of the mid region as dirty.
+ */
+static inline void
+mark_dirty (
+  ZLfoUi * self,
+  int      layers)
+{
+  self->has_change = 1;
+  self->dirty_layers |= layers;
+}
+
 #define GENERIC_GETTER(sc) \
 static float \
 sc##_getter ( \
@@ -264,7 +417,7 @@ sc##_getter ( \
   return self->sc; \
 }
 
-#define DEFINE_GET_SET(caps,sc) \
+#define DEFINE_GET_SET(caps,sc,layers) \
 GENERIC_GETTER (sc); \
 static void \
 sc##_setter ( \
@@ -276,14 +429,16 @@ sc##_setter ( \
   ztk_debug ( \
     "setting " #sc " to %f", (double) val); \
   SEND_PORT_EVENT (self, ZLFO_##caps, self->sc); \
-  self->has_change = 1; \
+  mark_dirty (self, layers); \
 }
 
-DEFINE_GET_SET (SHIFT, shift);
-DEFINE_GET_SET (SYNC_RATE, sync_rate);
-DEFINE_GET_SET (FREQ, freq);
-DEFINE_GET_SET (RANGE_MIN, range_min);
-DEFINE_GET_SET (RANGE_MAX, range_max);
+DEFINE_GET_SET (SHIFT, shift, LAYER_BIT (LAYER_WAVES));
+DEFINE_GET_SET (SYNC_RATE, sync_rate, 0);
+DEFINE_GET_SET (FREQ, freq, 0);
+DEFINE_GET_SET (
+  RANGE_MIN, range_min, LAYER_BIT (LAYER_WAVES));
+DEFINE_GET_SET (
+  RANGE_MAX, range_max, LAYER_BIT (LAYER_WAVES));
 
 #undef GENERIC_GETTER
 #undef DEFINE_GET_SET
@@ -295,9 +450,11 @@ node_pos_setter (
   float        val)
 {
   self->nodes[idx][0] = val;
-  SEND_PORT_EVENT (
-    self, ZLFO_NODE_1_POS + idx * 3, val);
-  self->has_change = 1;
+  self->nodes_edited = 1;
+  mark_dirty (
+    self,
+    LAYER_BIT (LAYER_WAVES) |
+    LAYER_BIT (LAYER_NODES));
 }
 
 static void
@@ -307,9 +464,11 @@ node_val_setter (
   float        val)
 {
   self->nodes[idx][1] = val;
-  SEND_PORT_EVENT (
-    self, ZLFO_NODE_1_VAL + idx * 3, val);
-  self->has_change = 1;
+  self->nodes_edited = 1;
+  mark_dirty (
+    self,
+    LAYER_BIT (LAYER_WAVES) |
+    LAYER_BIT (LAYER_NODES));
 }
 
 /**
@@ -349,9 +508,54 @@ num_nodes_setter (
   int          val)
 {
   self->num_nodes = val;
-  SEND_PORT_EVENT (
-    self, ZLFO_NUM_NODES, val);
-  self->has_change = 1;
+  self->nodes_edited = 1;
+  mark_dirty (
+    self,
+    LAYER_BIT (LAYER_WAVES) |
+    LAYER_BIT (LAYER_NODES));
+}
+
+/**
+ * Writes the node ports that changed since they
+ * were last written or received.
+ *
+ * The node setters only store the values, so that
+ * a drag writes each changed port once per idle
+ * call instead of once per motion event. The
+ * number of nodes is written last, so the DSP
+ * never uses a new node before its position.
+ */
+static void
+flush_node_edits (
+  ZLfoUi * self)
+{
+  if (!self->nodes_edited)
+    return;
+
+  for (unsigned int i = 0; i < 16; i++)
+    {
+      for (unsigned int j = 0; j < 3; j++)
+        {
+          if (math_doubles_equal (
+                (double) self->nodes[i][j],
+                (double) self->sent_nodes[i][j]))
+            continue;
+
+          self->sent_nodes[i][j] =
+            self->nodes[i][j];
+          SEND_PORT_EVENT (
+            self, ZLFO_NODE_1_POS + i * 3 + j,
+            self->nodes[i][j]);
+        }
+    }
+  if (self->num_nodes != self->sent_num_nodes)
+    {
+      self->sent_num_nodes = self->num_nodes;
+      SEND_PORT_EVENT (
+        self, ZLFO_NUM_NODES, self->num_nodes);
+    }
+
+  self->nodes_edited = 0;
 }
 
 static void
@@ -392,14 +596,6 @@ add_bg_widget (
     self->app, (ZtkWidget *) da, 0);
 }
 
-typedef struct ComboBoxElement
-{
-  int           id;
-  char          label[600];
-  ZtkComboBox * combo;
-  ZLfoUi *      zlfo_ui;
-} ComboBoxElement;
-
 static void
 sync_rate_type_activate_cb (
   ZtkWidget *       widget,
@@ -413,7 +609,7 @@ sync_rate_type_activate_cb (
   SEND_PORT_EVENT (
     self, ZLFO_SYNC_RATE_TYPE,
     self->sync_rate_type);
-  self->has_change = 1;
+  mark_dirty (self, 0);
 }
 
 static void
@@ -428,7 +624,7 @@ grid_step_activate_cb (
   self->grid_step = (float) el->id;
   SEND_PORT_EVENT (
     self, ZLFO_GRID_STEP, self->grid_step);
-  self->has_change = 1;
+  mark_dirty (self, LAYER_BIT (LAYER_WAVES));
 }
 
 /**
@@ -451,42 +647,50 @@ on_btn_clicked (
           self->step_mode = 0;
           SEND_PORT_EVENT (
             self, ZLFO_STEP_MODE, self->step_mode);
-          self->has_change = 1;
+          mark_dirty (self, LAYER_BIT (LAYER_WAVES));
           break;
         case TOP_BTN_STEP:
           self->step_mode = 1;
           SEND_PORT_EVENT (
             self, ZLFO_STEP_MODE, self->step_mode);
-          self->has_change = 1;
+          mark_dirty (self, LAYER_BIT (LAYER_WAVES));
           break;
         }
       break;
     case DATA_TYPE_BTN_LEFT:
       switch (data->val)
         {
-#define HANDLE_BTN(caps,lowercase) \
+#define HANDLE_BTN(caps,lowercase,layers) \
   case LEFT_BTN_##caps: \
     if (self->lowercase##_on) \
       { \
         self->lowercase##_on = 0; \
         SEND_PORT_EVENT ( \
           self, ZLFO_##caps##_TOGGLE, 0.f); \
-        self->has_change = 1; \
+        mark_dirty (self, layers); \
       } \
     else \
       { \
         self->lowercase##_on = 1; \
         SEND_PORT_EVENT ( \
           self, ZLFO_##caps##_TOGGLE, 1.f); \
-        self->has_change = 1; \
+        mark_dirty (self, layers); \
       } \
     break
-          HANDLE_BTN (SINE, sine);
-          HANDLE_BTN (SAW, saw);
-          HANDLE_BTN (TRIANGLE, triangle);
-          HANDLE_BTN (SQUARE, square);
-          HANDLE_BTN (CUSTOM, custom);
-          self->has_change = 1;
+          HANDLE_BTN (
+            SINE, sine, LAYER_BIT (LAYER_WAVES));
+          HANDLE_BTN (
+            SAW, saw, LAYER_BIT (LAYER_WAVES));
+          HANDLE_BTN (
+            TRIANGLE, triangle,
+            LAYER_BIT (LAYER_WAVES));
+          HANDLE_BTN (
+            SQUARE, square, LAYER_BIT (LAYER_WAVES));
+          HANDLE_BTN (
+            CUSTOM, custom,
+            LAYER_BIT (LAYER_WAVES) |
+            LAYER_BIT (LAYER_NODES));
+#undef HANDLE_BTN
         default:
           break;
         }
@@ -498,13 +702,13 @@ on_btn_clicked (
           self->freerun = 0;
           SEND_PORT_EVENT (
             self, ZLFO_FREE_RUNNING, self->freerun);
-          self->has_change = 1;
+          mark_dirty (self, 0);
           break;
         case BOT_BTN_FREE:
           self->freerun = 1;
           SEND_PORT_EVENT (
             self, ZLFO_FREE_RUNNING, self->freerun);
-          self->has_change = 1;
+          mark_dirty (self, 0);
           break;
         }
       break;
@@ -522,34 +726,8 @@ on_btn_clicked (
             for (int i = 0; i < NUM_GRID_STEPS; i++)
               {
                 ComboBoxElement * el =
-                  calloc (
-                    1, sizeof (ComboBoxElement));
-                el->id = i;
+                  &self->grid_step_elements[i];
                 el->combo = combo;
-                el->zlfo_ui = self;
-                switch (i)
-                  {
-                  case GRID_STEP_FULL:
-                    strcpy (el->label, "full");
-                    break;
-                  case GRID_STEP_HALF:
-                    strcpy (el->label, "1/2");
-                    break;
-                  case GRID_STEP_FOURTH:
-                    strcpy (el->label, "1/4");
-                    break;
-                  case GRID_STEP_EIGHTH:
-                    strcpy (el->label, "1/8");
-                    break;
-                  case GRID_STEP_SIXTEENTH:
-                    strcpy (el->label, "1/16");
-                    break;
-                  case GRID_STEP_THIRTY_SECOND:
-                    strcpy (el->label, "1/32");
-                    break;
-                  default:
-                    break;
-                  }
                 ztk_combo_box_add_text_element (
                   combo, el->label,
                   (ZtkWidgetActivateCallback)
@@ -561,13 +739,13 @@ on_btn_clicked (
           self->hinvert = !self->hinvert;
           SEND_PORT_EVENT (
             self, ZLFO_HINVERT, self->hinvert);
-          self->has_change = 1;
+          mark_dirty (self, LAYER_BIT (LAYER_WAVES));
           break;
         case GRID_BTN_VMIRROR:
           self->vinvert = !self->vinvert;
           SEND_PORT_EVENT (
             self, ZLFO_VINVERT, self->vinvert);
-          self->has_change = 1;
+          mark_dirty (self, LAYER_BIT (LAYER_WAVES));
           break;
         }
       break;
@@ -590,24 +768,8 @@ on_sync_rate_type_clicked (
   for (int i = 0; i < NUM_SYNC_RATE_TYPES; i++)
     {
       ComboBoxElement * el =
-        calloc (1, sizeof (ComboBoxElement));
-      el->id = i;
+        &self->sync_rate_type_elements[i];
       el->combo = combo;
-      el->zlfo_ui = self;
-      switch (i)
-        {
-        case SYNC_TYPE_NORMAL:
-          strcpy (el->label, "normal");
-          break;
-        case SYNC_TYPE_DOTTED:
-          strcpy (el->label, "dotted");
-          break;
-        case SYNC_TYPE_TRIPLET:
-          strcpy (el->label, "triplet");
-          break;
-        default:
-          break;
-        }
       ztk_combo_box_add_text_element (
         combo, el->label,
         (ZtkWidgetActivateCallback)
@@ -686,6 +848,104 @@ get_button_active (
   return 0;
 }
 
+/**
+ * Draws a button with the given background colors
+ * and SVGs for each state, blitting the SVG from
+ * the icon atlas.
+ *
+ * @param active Whether a toggled button is on,
+ *   drawn like a clicked one.
+ * @param normal_color Background color when not
+ *   hovered or clicked, or NULL to draw no
+ *   background.
+ */
+static void
+draw_svged_button (
+  ZLfoUi *        self,
+  ZtkWidget *     w,
+  cairo_t *       cr,
+  int             active,
+  ZtkColor *      normal_color,
+  ZtkColor *      hover_color,
+  ZtkColor *      click_color,
+  ZLfoSvg         normal_svg,
+  ZLfoSvg         hover_svg,
+  ZLfoSvg         click_svg,
+  int             hpadding,
+  int             vpadding)
+{
+  ZtkColor * color = normal_color;
+  ZLfoSvg svg = normal_svg;
+  if (w->state & ZTK_WIDGET_STATE_PRESSED ||
+      active)
+    {
+      color = click_color;
+      svg = click_svg;
+    }
+  else if (w->state & ZTK_WIDGET_STATE_HOVERED)
+    {
+      color = hover_color;
+      svg = hover_svg;
+    }
+
+  if (normal_color)
+    {
+      ztk_color_set_for_cairo (color, cr);
+      cairo_rectangle (
+        cr, w->rect.x, w->rect.y,
+        w->rect.width, w->rect.height);
+      cairo_fill (cr);
+    }
+
+  ZtkRect rect = {
+    w->rect.x + hpadding,
+    w->rect.y + vpadding,
+    w->rect.width - hpadding * 2,
+    w->rect.height - vpadding * 2 };
+  zlfo_ui_theme_draw_svg (
+    &self->ui_theme, svg, cr, &rect);
+}
+
+static void
+left_btn_bg_cb (
+  ZtkWidget * w,
+  cairo_t *   cr,
+  ZtkRect *   draw_rect,
+  DrawData *  data)
+{
+  ZLfoUi * self = data->zlfo_ui;
+
+  ZLfoSvg svg;
+  switch (data->val)
+    {
+    case LEFT_BTN_SINE:
+      svg = SVG_SINE;
+      break;
+    case LEFT_BTN_TRIANGLE:
+      svg = SVG_TRIANGLE;
+      break;
+    case LEFT_BTN_SAW:
+      svg = SVG_SAW;
+      break;
+    case LEFT_BTN_SQUARE:
+      svg = SVG_SQUARE;
+      break;
+    case LEFT_BTN_CUSTOM:
+      svg = SVG_CUSTOM;
+      break;
+    default:
+      return;
+    }
+
+  draw_svged_button (
+    self, w, cr,
+    get_button_active ((ZtkButton *) w, data),
+    &self->ui_theme.button_normal,
+    &self->ui_theme.button_hover,
+    &self->ui_theme.left_button_click,
+    svg, svg, svg, 8, 4);
+}
+
 static void
 add_left_buttons (
   ZLfoUi * self)
@@ -712,35 +972,10 @@ add_left_buttons (
         btn,
         (ZtkButtonToggledGetter)
         get_button_active);
-      ztk_button_set_background_colors (
+      ztk_button_add_background_callback (
         btn,
-        &self->ui_theme.button_normal,
-        &self->ui_theme.button_hover,
-        &self->ui_theme.left_button_click);
-
-#define MAKE_BUTTON_SVGED(caps,lowercase) \
-  case LEFT_BTN_##caps: \
-    { \
-      ztk_button_make_svged (\
-        btn, hpadding, vpadding, \
-        self->ui_theme.lowercase##_svg, \
-        self->ui_theme.lowercase##_svg, \
-        self->ui_theme.lowercase##_svg); \
-    } \
-    break
-
-      int hpadding = 8;
-      int vpadding = 4;
-      switch (data->val)
-        {
-          MAKE_BUTTON_SVGED (SINE, sine);
-          MAKE_BUTTON_SVGED (TRIANGLE, triangle);
-          MAKE_BUTTON_SVGED (SAW, saw);
-          MAKE_BUTTON_SVGED (SQUARE, square);
-          MAKE_BUTTON_SVGED (CUSTOM, custom);
-        }
-
-#undef MAKE_BUTTON_SVGED
+        (ZtkWidgetDrawCallback)
+        left_btn_bg_cb);
 
       ztk_app_add_widget (
         self->app, (ZtkWidget *) btn, 1);
@@ -810,6 +1045,26 @@ top_and_bot_btn_bg_cb (
         w->rect.y + height_with_border - 4, w->rect.width,
         4);
       cairo_fill (cr);
+
+      const int padding = 6;
+      ZtkRect rect = {
+        w->rect.x + padding,
+        w->rect.y + padding,
+        w->rect.width - padding * 2,
+        w->rect.height - padding * 2 };
+      switch (data->val)
+        {
+        case TOP_BTN_CURVE:
+          zlfo_ui_theme_draw_svg (
+            &self->ui_theme,
+            SVG_CURVE, cr, &rect);
+          break;
+        case TOP_BTN_STEP:
+          zlfo_ui_theme_draw_svg (
+            &self->ui_theme,
+            SVG_STEP, cr, &rect);
+          break;
+        }
     }
   else if (data->type == DATA_TYPE_BTN_BOT)
     {
@@ -872,15 +1127,16 @@ top_and_bot_btn_bg_cb (
       { \
         rect.x -= FREQ_BOX_WIDTH / 2.0; \
       } \
-    ztk_rsvg_draw ( \
-      self->ui_theme.svg##_svg, cr, &rect); \
+    zlfo_ui_theme_draw_svg ( \
+      &self->ui_theme, \
+      SVG_##svg, cr, &rect); \
   } \
       break
 
       switch (data->val)
         {
-          DRAW_SVG (SYNC, sync);
-          DRAW_SVG (FREE, freeb);
+          DRAW_SVG (SYNC, SYNC);
+          DRAW_SVG (FREE, FREEB);
         }
 
 #undef DRAW_SVG
@@ -919,27 +1175,6 @@ add_top_buttons (
         (ZtkButtonToggledGetter)
         get_button_active);
 
-#define MAKE_BUTTON_SVGED(caps,lowercase) \
-  case TOP_BTN_##caps: \
-    { \
-      ztk_button_make_svged (\
-        btn, hpadding, vpadding, \
-        self->ui_theme.lowercase##_svg, \
-        self->ui_theme.lowercase##_svg, \
-        self->ui_theme.lowercase##_svg); \
-    } \
-    break
-
-      int hpadding = 6;
-      int vpadding = 6;
-      switch (data->val)
-        {
-          MAKE_BUTTON_SVGED (CURVE, curve);
-          MAKE_BUTTON_SVGED (STEP, step);
-        }
-
-#undef MAKE_BUTTON_SVGED
-
       ztk_app_add_widget (
         self->app, (ZtkWidget *) btn, 1);
     }
@@ -1090,7 +1325,7 @@ sync_rate_control_btn_event_cb (
           self->freerun = 0;
           SEND_PORT_EVENT (
             self, ZLFO_FREE_RUNNING, self->freerun);
-          self->has_change = 1;
+          mark_dirty (self, 0);
         }
     }
   return 1;
@@ -1110,12 +1345,28 @@ freq_control_btn_event_cb (
           self->freerun = 1;
           SEND_PORT_EVENT (
             self, ZLFO_FREE_RUNNING, self->freerun);
-          self->has_change = 1;
+          mark_dirty (self, 0);
         }
     }
   return 1;
 }
 
+static void
+sync_rate_type_btn_bg_cb (
+  ZtkWidget * w,
+  cairo_t *   cr,
+  ZtkRect *   draw_rect,
+  ZLfoUi *    self)
+{
+  ZtkColor bg = { 0, 0, 0, 1 };
+  draw_svged_button (
+    self, w, cr, 0, &bg,
+    &self->ui_theme.button_hover,
+    &self->ui_theme.bright_click,
+    SVG_DOWN_ARROW, SVG_DOWN_ARROW,
+    SVG_DOWN_ARROW, 3, 0);
+}
+
 static void
 add_bot_buttons (
   ZLfoUi * self)
@@ -1191,17 +1442,10 @@ add_bot_buttons (
       &rect,
       (ZtkWidgetActivateCallback)
       on_sync_rate_type_clicked, self);
-  ZtkColor bg = { 0, 0, 0, 1 };
-  ztk_button_set_background_colors (
+  ztk_button_add_background_callback (
     btn,
-    &bg,
-    &self->ui_theme.button_hover,
-    &self->ui_theme.bright_click);
-  ztk_button_make_svged (
-    btn, 3, 0,
-    self->ui_theme.down_arrow_svg,
-    self->ui_theme.down_arrow_svg,
-    self->ui_theme.down_arrow_svg);
+    (ZtkWidgetDrawCallback)
+    sync_rate_type_btn_bg_cb);
   ztk_app_add_widget (
     self->app, (ZtkWidget *) btn, 4);
 
@@ -1231,313 +1475,676 @@ add_bot_buttons (
 }
 
 /**
- * Draws the graphs in curve mode.
+ * Fills in the snapshot the preview is rendered
+ * from with the same kernel as the DSP.
+ *
+ * The period is GRID_WIDTH samples long, so each
+ * sample corresponds to a pixel column. The values
+ * include the inversion, shift, step mode and
+ * range, exactly as the DSP would output them.
+ */
+static void
+get_preview_params (
+  ZLfoUi *    self,
+  LfoParams * params)
+{
+  memset (params, 0, sizeof (LfoParams));
+  params->period_size = GRID_WIDTH;
+  params->sine_multiplier =
+    (2.f * PI) / (float) GRID_WIDTH;
+  params->enabled[WAVEFORM_SINE] = self->sine_on;
+  params->enabled[WAVEFORM_TRIANGLE] =
+    self->triangle_on;
+  params->enabled[WAVEFORM_SAW] = self->saw_on;
+  params->enabled[WAVEFORM_SQUARE] =
+    self->square_on;
+  params->enabled[WAVEFORM_CUSTOM] =
+    self->custom_on;
+  params->hinvert = self->hinvert;
+  params->vinvert = self->vinvert;
+  params->step_mode = self->step_mode;
+  params->shift = self->shift;
+  params->range_min = self->range_min;
+  params->range_max = self->range_max;
+  params->grid_step = (GridStep) self->grid_step;
+  params->num_nodes = self->num_nodes;
+  memcpy (
+    params->nodes, self->nodes,
+    sizeof (params->nodes));
+  prepare_params (params);
+}
+
+/**
+ * Draws the graphs in curve mode.
+ *
+ * Each waveform is built as a single path (a
+ * polyline, or one bar per step in step mode) and
+ * stroked once.
+ *
+ * Only uses the job, so it can run on the preview
+ * worker.
+ */
+static void
+draw_graph (
+  const PreviewJob * job,
+  cairo_t *          cr)
+{
+  const LfoParams * params = &job->params;
+
+  /* one period, one value per pixel column */
+  float preview[NUM_WAVEFORMS][GRID_WIDTH];
+  float * outs[NUM_WAVEFORMS];
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      outs[i] =
+        params->enabled[i] ? preview[i] : NULL;
+    }
+  render_frames (params, 0, GRID_WIDTH, outs);
+
+  double grid_step_divisor =
+    (double)
+    grid_step_to_divisor (params->grid_step);
+  double step_px = GRID_WIDTH / grid_step_divisor;
+
+  cairo_set_source_rgba (
+    cr, job->color.red, job->color.green,
+    job->color.blue, GRAPH_OVERLAY_ALPHA);
+  cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
+  cairo_set_line_join (cr, CAIRO_LINE_JOIN_BEVEL);
+  if (params->step_mode)
+    cairo_set_line_width (cr, step_px);
+  else
+    cairo_set_line_width (cr, 6);
+
+  for (int wave = 0; wave < NUM_WAVEFORMS; wave++)
+    {
+      if (!params->enabled[wave])
+        continue;
+
+      int i = 0;
+      double idouble = 0;
+      if (params->step_mode)
+        {
+          idouble = step_px / 2.0;
+          i = (int) idouble;
+        }
+      /* we are approximating so be sure it
+       * doesn't go beyond the width by small
+       * decimals */
+      while (idouble < GRID_WIDTH - 0.01)
+        {
+          /* the value is already inverted and
+           * adjusted to the range */
+          double val =
+            (double) preview[wave][i];
+
+          double draw_val =
+            ((val + 1.0) * GRID_HEIGHT) / 2.0;
+
+          /* invert because higher Y means lower
+           * in cairo */
+          draw_val = GRID_HEIGHT - draw_val;
+
+          if (params->step_mode)
+            {
+              /* add a bar */
+              cairo_move_to (
+                cr,
+                GRID_XSTART_GLOBAL + idouble,
+                GRID_YSTART_GLOBAL + GRID_HEIGHT);
+              cairo_line_to (
+                cr,
+                GRID_XSTART_GLOBAL + idouble,
+                GRID_YSTART_GLOBAL + draw_val);
+
+              idouble += step_px;
+              i = (int) idouble;
+            }
+          else
+            {
+              /* extend the polyline */
+              if (i == 0)
+                {
+                  cairo_move_to (
+                    cr, GRID_XSTART_GLOBAL,
+                    GRID_YSTART_GLOBAL + draw_val);
+                }
+              else
+                {
+                  cairo_line_to (
+                    cr, GRID_XSTART_GLOBAL + i,
+                    GRID_YSTART_GLOBAL + draw_val);
+                }
+
+              i++;
+              idouble = (double) i;
+            }
+        }
+      cairo_stroke (cr);
+    }
+}
+
+/**
+ * Draws the waveform layer of the job on a new
+ * image surface.
+ */
+static cairo_surface_t *
+draw_preview_layer (
+  const PreviewJob * job)
+{
+  cairo_surface_t * surface =
+    cairo_image_surface_create (
+      CAIRO_FORMAT_ARGB32,
+      (int) ceil (job->rect.width),
+      (int) ceil (job->rect.height));
+
+  /* draw in window coordinates */
+  cairo_t * cr = cairo_create (surface);
+  cairo_translate (cr, - job->rect.x, - job->rect.y);
+  draw_graph (job, cr);
+  cairo_destroy (cr);
+
+  cairo_surface_flush (surface);
+
+  return surface;
+}
+
+/**
+ * Draws the latest requested waveform layer until
+ * asked to quit.
+ *
+ * Requests made while drawing replace each other,
+ * so only the newest one is drawn next, and a
+ * result is dropped if a newer request was made
+ * while drawing it.
+ */
+static gpointer
+preview_worker (
+  gpointer data)
+{
+  ZLfoUi * self = (ZLfoUi *) data;
+
+  g_mutex_lock (&self->preview_mutex);
+  while (!self->preview_quit)
+    {
+      if (!self->preview_job_pending)
+        {
+          g_cond_wait (
+            &self->preview_cond,
+            &self->preview_mutex);
+          continue;
+        }
+
+      PreviewJob job = self->preview_job;
+      self->preview_job_pending = 0;
+      g_mutex_unlock (&self->preview_mutex);
+
+      cairo_surface_t * surface =
+        draw_preview_layer (&job);
+
+      g_mutex_lock (&self->preview_mutex);
+      if (job.generation !=
+            self->preview_generation)
+        {
+          cairo_surface_destroy (surface);
+          continue;
+        }
+      if (self->preview_result)
+        cairo_surface_destroy (
+          self->preview_result);
+      self->preview_result = surface;
+    }
+  g_mutex_unlock (&self->preview_mutex);
+
+  return NULL;
+}
+
+/**
+ * Asks the worker to draw the waveform layer for
+ * the current values.
+ */
+static void
+request_preview (
+  ZLfoUi *    self,
+  ZtkWidget * widget)
+{
+  PreviewJob job;
+  get_preview_params (self, &job.params);
+  job.color = self->ui_theme.left_button_click;
+  job.rect = widget->rect;
+
+  g_mutex_lock (&self->preview_mutex);
+  job.generation = ++self->preview_generation;
+  self->preview_job = job;
+  self->preview_job_pending = 1;
+  g_cond_signal (&self->preview_cond);
+  g_mutex_unlock (&self->preview_mutex);
+}
+
+/**
+ * Takes the layer drawn by the worker, if a new
+ * one is ready.
+ *
+ * @return Whether the layer changed.
+ */
+static int
+collect_preview (
+  ZLfoUi * self)
+{
+  g_mutex_lock (&self->preview_mutex);
+  cairo_surface_t * surface =
+    self->preview_result;
+  self->preview_result = NULL;
+  g_mutex_unlock (&self->preview_mutex);
+
+  if (!surface)
+    return 0;
+
+  if (self->layer_surfaces[LAYER_WAVES])
+    cairo_surface_destroy (
+      self->layer_surfaces[LAYER_WAVES]);
+  self->layer_surfaces[LAYER_WAVES] = surface;
+
+  return 1;
+}
+
+/**
+ * Returns the center of the given node in the
+ * window.
+ */
+static void
+get_node_center (
+  ZLfoUi * self,
+  int      idx,
+  double * x,
+  double * y)
+{
+  *x =
+    GRID_XSTART_GLOBAL +
+    (double) self->nodes[idx][0] * GRID_WIDTH;
+  *y =
+    GRID_YSTART_GLOBAL +
+    (1.0 - (double) self->nodes[idx][1]) *
+      GRID_HEIGHT;
+}
+
+/**
+ * Draws the lines between the custom nodes as a
+ * single polyline through the nodes in order,
+ * ending at the first node reappearing at the
+ * end.
+ *
+ * The node widgets draw themselves on top.
+ */
+static void
+draw_node_curves (
+  ZLfoUi *  self,
+  cairo_t * cr)
+{
+  if (!self->custom_on)
+    return;
+
+  /* sort node curves by position */
+  int num_nodes = CLAMP (self->num_nodes, 1, 16);
+  NodeIndexElement node_indices[num_nodes];
+  sort_node_indices_by_pos (
+    self->nodes, node_indices, num_nodes);
+
+  zlfo_ui_theme_set_cr_color (&self->ui_theme, cr, line);
+  cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
+  cairo_set_line_join (cr, CAIRO_LINE_JOIN_BEVEL);
+  cairo_set_line_width (cr, 6);
+  double x, y;
+  for (int i = 0; i < num_nodes; i++)
+    {
+      get_node_center (
+        self, node_indices[i].index, &x, &y);
+      if (i == 0)
+        cairo_move_to (cr, x, y);
+      else
+        cairo_line_to (cr, x, y);
+    }
+
+  get_node_center (self, 0, &x, &y);
+  x = GRID_XEND_GLOBAL;
+  cairo_line_to (cr, x, y);
+  cairo_stroke (cr);
+
+  /* draw faded end node */
+  zlfo_ui_theme_set_cr_color (&self->ui_theme, cr, selected_bg);
+  cairo_arc (
+    cr, x, y, NODE_WIDTH / 2.0, 0, 2 * G_PI);
+  cairo_fill (cr);
+  zlfo_ui_theme_set_cr_color (&self->ui_theme, cr, line);
+  cairo_set_line_width (cr, 4);
+  cairo_arc (
+    cr, x, y, NODE_WIDTH / 2.0, 0, 2 * G_PI);
+  cairo_stroke (cr);
+}
+
+/**
+ * Draws the background and the grid lines.
+ */
+static void
+draw_grid (
+  ZLfoUi *    self,
+  cairo_t *   cr,
+  ZtkWidget * widget)
+{
+  /* set background */
+  zlfo_ui_theme_set_cr_color (
+    &self->ui_theme, cr, selected_bg);
+  cairo_rectangle (
+    cr, widget->rect.x, widget->rect.y,
+    widget->rect.width, widget->rect.height);
+  cairo_fill (cr);
+
+  /* draw grid */
+  for (int i = 0; i < 9; i++)
+    {
+      if ((i % 4) == 0)
+        {
+          zlfo_ui_theme_set_cr_color (
+            &self->ui_theme, cr, grid_strong);
+        }
+      else
+        {
+          zlfo_ui_theme_set_cr_color (
+            &self->ui_theme, cr, grid);
+        }
+      cairo_move_to (
+        cr,
+        widget->rect.x + GRID_HPADDING +
+          i * GRID_SPACE,
+        widget->rect.y + GRID_YSTART_OFFSET);
+      cairo_line_to (
+        cr,
+        widget->rect.x + GRID_HPADDING +
+          i * GRID_SPACE,
+        widget->rect.y + GRID_YEND_OFFSET);
+      cairo_stroke (cr);
+    }
+  zlfo_ui_theme_set_cr_color (
+    &self->ui_theme, cr, grid_strong);
+  cairo_move_to (
+    cr,
+    GRID_XSTART_GLOBAL,
+    widget->rect.y + 105);
+  cairo_line_to (
+    cr,
+    GRID_XEND_GLOBAL,
+    widget->rect.y + 105);
+  cairo_stroke (cr);
+}
+
+/**
+ * Recalculates the period and advances the
+ * current sample by the time elapsed since the
+ * last call.
+ */
+static void
+update_current_sample (
+  ZLfoUi * self)
+{
+  float sync_rate_float =
+    sync_rate_to_float (
+      self->sync_rate,
+      self->sync_rate_type);
+
+  /**
+   * Effective frequency.
+   *
+   * This is either the free-running frequency,
+   * or the frequency corresponding to the current
+   * sync rate.
+   */
+  float effective_freq =
+    get_effective_freq (
+      self->freerun, self->freq,
+      &self->common.host_pos, sync_rate_float);
+
+  /* calculate current sample */
+  gint64 cur_time = g_get_monotonic_time ();
+  if (self->last_current_sample_set == 0 ||
+      (!self->freerun &&
+          self->common.host_pos.speed < 0.001f))
+    {
+      self->last_current_sample_set = cur_time;
+    }
+  else if (self->common.period_size > 0)
+    {
+      double samples_diff =
+        ((double) self->common.samplerate *
+         ((double)
+           (cur_time -
+              self->last_current_sample_set) /
+           1000000.0));
+      self->current_sample += samples_diff;
+      while (self->current_sample >=
+               (double) self->common.period_size)
+        {
+          self->current_sample -=
+            (double) self->common.period_size;
+        }
+      self->last_current_sample_set = cur_time;
+    }
+
+  recalc_vars (
+    self->freerun,
+    &self->common.sine_multiplier,
+    &self->common.saw_multiplier,
+    &self->common.period_size,
+    NULL,
+    &self->common.host_pos, effective_freq,
+    sync_rate_float,
+    (float) self->common.samplerate);
+}
+
+/**
+ * Returns the X of the playhead in the window.
+ */
+static double
+get_playhead_x (
+  ZLfoUi * self)
+{
+  double current_offset =
+    self->common.period_size > 0 ?
+      self->current_sample /
+        (double) self->common.period_size :
+      0.0;
+
+  return
+    self->mid_region->rect.x + GRID_HPADDING +
+    current_offset * GRID_WIDTH;
+}
+
+/**
+ * Posts a redisplay of the parts of the window
+ * that changed.
+ *
+ * Anything other than the playhead, the scope,
+ * the waves drawn by the preview worker and the
+ * DSP load redraws the whole window. Otherwise
+ * only the strips covering the old and new
+ * playhead, the grid for the scope, the mid region
+ * for new waves and the DSP load strip are
+ * redrawn.
  */
 static void
-draw_graph (
-  ZLfoUi *  self,
-  cairo_t * cr)
+redraw_mid_region (
+  ZLfoUi * self)
 {
-  double max_range =
-    MAX (self->range_max, self->range_min);
-  double min_range =
-    MIN (self->range_max, self->range_min);
-  double range = max_range - min_range;
-
-  double grid_step_divisor =
-    (double)
-    grid_step_to_divisor (
-      (GridStep) self->grid_step);
-  double step_px = GRID_WIDTH / grid_step_divisor;
-
-  /* sort node curves by position */
-  NodeIndexElement node_indices[self->num_nodes];
-  sort_node_indices_by_pos (
-    self->nodes, node_indices,
-    self->num_nodes);
-
-  if (self->has_change)
+  if (self->has_change || self->dirty_layers)
     {
-      for (int i = 0; i < GRID_WIDTH; i++)
-        {
-          self->sine_cache[i] =
-            sinf (
-              ((float) i * 2.f * PI) /
-              (float) GRID_WIDTH);
-          self->saw_cache[i] =
-            (1.f - (float) i / (float) GRID_WIDTH) *
-            2.f - 1.f;
-        }
-      /*g_message ("has change");*/
+      puglPostRedisplay (
+        self->app->view);
+      return;
     }
 
-  cairo_set_source_rgba (
-    cr, self->ui_theme.left_button_click.red,
-    self->ui_theme.left_button_click.green,
-    self->ui_theme.left_button_click.blue,
-    GRAPH_OVERLAY_ALPHA);
-  cairo_set_line_cap (cr, CAIRO_LINE_CAP_BUTT);
-  if (self->step_mode)
-    cairo_set_line_width (cr, step_px);
-  else
-    cairo_set_line_width (cr, 6);
-  double prev_draw_sine,
-         prev_draw_triangle,
-         prev_draw_saw, prev_draw_square,
-         prev_draw_custom;
-  int i = 0;
-  double idouble = 0;
-  if (self->step_mode)
-    {
-      idouble = step_px / 2.0;
-      i = (int) idouble;
-    }
-   /* we are approximating so be sure it
-    * doesn't go beyond the width by small
-    * decimals */
-  while (idouble < GRID_WIDTH - 0.01)
-    {
-      /* from 0 to GRID_WIDTH */
-      long xvall = (long) i;
-      double xvald = (double) i;
-
-      xvall =
-        invert_and_shift_xval (
-          i, GRID_WIDTH, self->hinvert,
-          self->shift);
-      xvald = (double) xvall;
-
-#define DRAW_VAL(val) \
-  /* invert vertically */ \
-  if (self->vinvert) \
-    { \
-      val = - val; \
-    } \
- \
-  /* adjust range */ \
-  val = \
-    min_range + \
-  ((val + 1.0) / 2.0) * range; \
- \
-  double draw_val = \
-    ((val + 1.0) * GRID_HEIGHT) / 2.0; \
- \
-  /* invert because higher Y means lower \
-   * in cairo */ \
-  draw_val = GRID_HEIGHT - draw_val; \
- \
-  if (self->step_mode) \
-    { \
-      /* draw line */ \
-      cairo_move_to ( \
-        cr, \
-        GRID_XSTART_GLOBAL + idouble, \
-        GRID_YSTART_GLOBAL + GRID_HEIGHT); \
-      cairo_line_to ( \
-        cr, \
-        GRID_XSTART_GLOBAL + idouble, \
-        GRID_YSTART_GLOBAL + draw_val); \
-      cairo_stroke (cr); \
-    } \
-  else if (i != 0) \
-    { \
-      /* draw line */ \
-      cairo_move_to ( \
-        cr, \
-        GRID_XSTART_GLOBAL + i - 1, \
-        GRID_YSTART_GLOBAL + \
-          prev_draw_##val); \
-      cairo_line_to ( \
-        cr, \
-        GRID_XSTART_GLOBAL + i, \
-        GRID_YSTART_GLOBAL + \
-          draw_val); \
-      cairo_stroke (cr); \
-    } \
-  prev_draw_##val = draw_val
-
-      double ratio = xvald / GRID_WIDTH;
-
-      if (self->sine_on)
-        {
-          /* calculate sine */
-          double sine =
-            (double) self->sine_cache[xvall];
-
-          DRAW_VAL (sine);
-        }
-      if (self->saw_on)
-        {
-          /* calculate saw */
-          double saw =
-            (double) self->saw_cache[xvall];
+  ZtkRect * mid_rect = &self->mid_region->rect;
 
-          DRAW_VAL (saw);
-        }
-      if (self->triangle_on)
-        {
-          double triangle;
-          if (ratio > 0.4999)
-            {
-              triangle =
-                (1.0 - ratio) * 4.0 - 1.0;
-            }
-          else
-            {
-              triangle =
-                ratio * 4.0 - 1.0;
-            }
+  if (collect_preview (self))
+    {
+      PuglRect rect;
+      rect.x = mid_rect->x;
+      rect.y = mid_rect->y;
+      rect.width = mid_rect->width;
+      rect.height = mid_rect->height;
+      puglPostRedisplayRect (
+        self->app->view, rect);
+    }
 
-          DRAW_VAL (triangle);
-        }
-      if (self->square_on)
-        {
-          double square;
-          if (ratio > 0.4999)
-            {
-              square = - 1.0;
-            }
-          else
-            {
-              square = 1.0;
-            }
+  double playhead_x = get_playhead_x (self);
+  if (!math_doubles_equal (
+         playhead_x, self->last_playhead_x))
+    {
+      double min_x =
+        MIN (playhead_x, self->last_playhead_x);
+      double max_x =
+        MAX (playhead_x, self->last_playhead_x);
+      PuglRect rect;
+      rect.x = min_x - PLAYHEAD_LINE_WIDTH;
+      rect.y = mid_rect->y + GRID_YSTART_OFFSET;
+      rect.width =
+        (max_x - min_x) + 2 * PLAYHEAD_LINE_WIDTH;
+      rect.height =
+        GRID_YEND_OFFSET - GRID_YSTART_OFFSET;
+      puglPostRedisplayRect (
+        self->app->view, rect);
+    }
 
-          DRAW_VAL (square);
-        }
-      if (self->custom_on)
-        {
-          int prev_idx =
-            get_prev_idx (
-              node_indices, self->num_nodes,
-              (float) ratio);
-          int next_idx =
-            get_next_idx (
-              node_indices, self->num_nodes,
-              (float) ratio);
-
-          /* calculate custom */
-          double custom =
-            (double)
-            get_custom_val_at_x (
-              self->nodes[prev_idx][0],
-              self->nodes[prev_idx][1],
-              self->nodes[prev_idx][2],
-              next_idx < 0 ? 1.f :
-                self->nodes[next_idx][0],
-              next_idx < 0 ?
-                self->nodes[0][1] :
-                self->nodes[next_idx][1],
-              next_idx < 0 ?
-                self->nodes[0][2] :
-                self->nodes[next_idx][2],
-              (float) xvald, GRID_WIDTH);
-
-          /* adjust for -1 to 1 */
-          custom = custom * 2 - 1;
-
-          DRAW_VAL (custom);
-        }
+  if (self->scope_changed)
+    {
+      PuglRect rect;
+      rect.x = GRID_XSTART_GLOBAL;
+      rect.y = GRID_YSTART_GLOBAL;
+      rect.width = GRID_WIDTH;
+      rect.height = GRID_HEIGHT;
+      puglPostRedisplayRect (
+        self->app->view, rect);
+    }
 
-      if (self->step_mode)
-        {
-          idouble += step_px;
-          i = (int) idouble;
-        }
-      else
-        {
-          i++;
-          idouble = (double) i;
-        }
+  if (self->dsp_load_changed)
+    {
+      PuglRect rect;
+      rect.x = mid_rect->x;
+      rect.y =
+        mid_rect->y + MID_REGION_HEIGHT -
+        DSP_LOAD_STRIP_HEIGHT;
+      rect.width = mid_rect->width;
+      rect.height = DSP_LOAD_STRIP_HEIGHT;
+      puglPostRedisplayRect (
+        self->app->view, rect);
     }
-#undef DRAW_VAL
+}
 
-  if (self->custom_on)
+/**
+ * Draws the scope trace of the enabled waveforms,
+ * oldest column on the left, as a vertical line
+ * from the min to the max of each column.
+ */
+static void
+draw_scope (
+  ZLfoUi *  self,
+  cairo_t * cr)
+{
+  int wave_on[NUM_WAVEFORMS] = {
+    [WAVEFORM_SINE] = self->sine_on,
+    [WAVEFORM_TRIANGLE] = self->triangle_on,
+    [WAVEFORM_SAW] = self->saw_on,
+    [WAVEFORM_SQUARE] = self->square_on,
+    [WAVEFORM_CUSTOM] = self->custom_on,
+  };
+
+  cairo_set_source_rgba (cr, 1, 1, 1, SCOPE_ALPHA);
+  cairo_set_line_width (cr, 1);
+  cairo_set_line_cap (cr, CAIRO_LINE_CAP_SQUARE);
+  double col_width =
+    (double) GRID_WIDTH / SCOPE_SIZE;
+  for (int wave = 0; wave < NUM_WAVEFORMS; wave++)
     {
-      /* draw node curves */
-      zlfo_ui_theme_set_cr_color (&self->ui_theme, cr, line);
-      cairo_set_line_width (cr, 6);
-      for (i = 0; i < self->num_nodes - 1; i++)
-        {
-          int index = node_indices[i].index;
-          int next_index =
-            node_indices[i + 1].index;
-          ZtkWidget * nodew =
-            self->node_widgets[index];
-          ZtkWidget * next_nodew =
-            self->node_widgets[next_index];
+      if (!wave_on[wave])
+        continue;
 
+      /* the newest column is on the right */
+      for (int i = SCOPE_SIZE - self->scope_num_columns;
+           i < SCOPE_SIZE; i++)
+        {
+          const float * col =
+            self->scope[
+              (self->scope_pos + i) % SCOPE_SIZE][wave];
+          double x =
+            GRID_XSTART_GLOBAL + (i + 0.5) * col_width;
+          double min_y =
+            GRID_HEIGHT -
+            (((double) col[0] + 1.0) * GRID_HEIGHT) /
+              2.0;
+          double max_y =
+            GRID_HEIGHT -
+            (((double) col[1] + 1.0) * GRID_HEIGHT) /
+              2.0;
           cairo_move_to (
-            cr,
-            nodew->rect.x + nodew->rect.width / 2,
-            nodew->rect.y + nodew->rect.height / 2);
+            cr, x, GRID_YSTART_GLOBAL + min_y);
           cairo_line_to (
-            cr,
-            next_nodew->rect.x +
-              next_nodew->rect.width / 2,
-            next_nodew->rect.y +
-              next_nodew->rect.height / 2);
-          cairo_stroke (cr);
+            cr, x, GRID_YSTART_GLOBAL + max_y);
         }
-
-      /* draw line from last node to first node
-       * reappearing at the end */
-      ZtkWidget * first_nodew =
-        self->node_widgets[0];
-      ZtkWidget * last_nodew =
-        self->node_widgets[
-          node_indices[self->num_nodes - 1].index];
-      ZtkRect rect = first_nodew->rect;
-      rect.x = GRID_XEND_GLOBAL - rect.width / 2;
-
-      /* draw line */
-      cairo_move_to (
-        cr,
-        last_nodew->rect.x +
-          last_nodew->rect.width / 2,
-        last_nodew->rect.y +
-          last_nodew->rect.height / 2);
-      cairo_line_to (
-        cr,
-        rect.x + rect.width / 2,
-        rect.y + rect.height / 2);
-      cairo_stroke (cr);
-
-      /* draw faded end node */
-      zlfo_ui_theme_set_cr_color (&self->ui_theme, cr, selected_bg);
-      cairo_arc (
-        cr,
-        rect.x + rect.width / 2,
-        rect.y + rect.width / 2,
-        rect.width / 2,
-        0, 2 * G_PI);
-      cairo_fill (cr);
-      zlfo_ui_theme_set_cr_color (&self->ui_theme, cr, line);
-      cairo_set_line_width (cr, 4);
-      cairo_arc (
-        cr,
-        rect.x + rect.width / 2,
-        rect.y + rect.width / 2,
-        rect.width / 2,
-        0, 2 * G_PI);
-      cairo_stroke (cr);
     }
+  cairo_stroke (cr);
 }
 
+/**
+ * Draws the DSP load statistics at the bottom of
+ * the mid region.
+ */
 static void
-redraw_mid_region (
-  ZLfoUi * self)
+draw_dsp_load (
+  ZLfoUi *    self,
+  cairo_t *   cr,
+  ZtkWidget * widget)
 {
-#if 0
-  PuglRect rect;
-  rect.x = GRID_XSTART_GLOBAL;
-  rect.y = GRID_YSTART_GLOBAL;
-  rect.width = GRID_WIDTH;
-  rect.height = GRID_HEIGHT;
-  puglPostRedisplayRect (
-    self->app->view, rect);
-#endif
-  puglPostRedisplay (
-    self->app->view);
+  DspLoad * load = &self->dsp_load;
+  if (load->num_blocks == 0)
+    return;
+
+  double x = widget->rect.x + GRID_HPADDING;
+  double y =
+    widget->rect.y + MID_REGION_HEIGHT - 4;
+
+  /* draw label */
+  char lbl[100];
+  snprintf (
+    lbl, 100,
+    "DSP %.1f cycles/sample (min %.1f max %.1f)",
+    (double) load->avg, (double) load->min,
+    (double) load->max);
+  cairo_text_extents_t extents;
+  cairo_set_font_size (cr, 8);
+  cairo_text_extents (cr, lbl, &extents);
+  cairo_set_source_rgba (cr, 1, 1, 1, 0.6);
+  cairo_move_to (cr, x, y);
+  cairo_show_text (cr, lbl);
+
+  /* draw histogram */
+  int max_count = 1;
+  for (int i = 0; i < DSP_LOAD_HISTOGRAM_SIZE; i++)
+    {
+      max_count =
+        MAX (max_count, load->histogram[i]);
+    }
+  const double bar_width = 3;
+  const double max_bar_height = 8;
+  x += extents.x_advance + 6;
+  for (int i = 0; i < DSP_LOAD_HISTOGRAM_SIZE; i++)
+    {
+      double height =
+        max_bar_height *
+        (double) load->histogram[i] /
+        (double) max_count;
+      cairo_rectangle (
+        cr, x + i * (bar_width + 1), y - height,
+        bar_width, height);
+    }
+  cairo_fill (cr);
 }
 
 static void
@@ -1547,142 +2154,78 @@ mid_region_bg_draw_cb (
   ZtkRect *   draw_rect,
   ZLfoUi *    self)
 {
-  if (self->has_change ||
-      !ztk_rect_is_equal (
-        draw_rect, &self->last_rect))
+  /* redraw the dirty layers */
+  collect_preview (self);
+  for (int i = 0; i < NUM_LAYERS; i++)
     {
-      /*ztk_message ("change");*/
-      ztk_rect_copy (
-        &self->last_rect, draw_rect);
-      z_cairo_reset_caches (
-        &self->cached_cr,
-        &self->cached_surface,
-        (int) WIDTH,
-        (int) HEIGHT, cr);
-
-      /* set background */
-      zlfo_ui_theme_set_cr_color (
-        &self->ui_theme, self->cached_cr, selected_bg);
-      cairo_rectangle (
-        self->cached_cr, widget->rect.x, widget->rect.y,
-        widget->rect.width, widget->rect.height);
-      cairo_fill (self->cached_cr);
-
-      float sync_rate_float =
-        sync_rate_to_float (
-          self->sync_rate,
-          self->sync_rate_type);
-
-      /**
-       * Effective frequency.
-       *
-       * This is either the free-running frequency,
-       * or the frequency corresponding to the current
-       * sync rate.
-       */
-      float effective_freq =
-        get_effective_freq (
-          self->freerun, self->freq,
-          &self->common.host_pos, sync_rate_float);
-
-      /* calculate current sample */
-      gint64 cur_time = g_get_monotonic_time ();
-      if (self->last_current_sample_set == 0 ||
-          (!self->freerun &&
-              self->common.host_pos.speed < 0.001f))
-        {
-          self->last_current_sample_set = cur_time;
-        }
-      else
+      /* the worker draws the waves, the last ones
+       * drawn are shown until it is done */
+      if (i == LAYER_WAVES)
         {
-          double samples_diff =
-            ((double) self->common.samplerate *
-             ((double)
-               (cur_time -
-                  self->last_current_sample_set) /
-               1000000.0));
-          self->current_sample += samples_diff;
-          while (self->current_sample >=
-                   (double) self->common.period_size)
-            {
-              self->current_sample -=
-                (double) self->common.period_size;
-            }
-          self->last_current_sample_set = cur_time;
+          if (self->dirty_layers & LAYER_BIT (i))
+            request_preview (self, widget);
+          continue;
         }
 
-      /* draw grid */
-      for (int i = 0; i < 9; i++)
+      if (self->layer_surfaces[i] &&
+          !(self->dirty_layers & LAYER_BIT (i)))
+        continue;
+
+      z_cairo_reset_caches (
+        &self->layer_crs[i],
+        &self->layer_surfaces[i],
+        (int) widget->rect.width,
+        (int) widget->rect.height, cr);
+
+      /* draw in window coordinates */
+      cairo_t * layer_cr = self->layer_crs[i];
+      cairo_translate (
+        layer_cr, - widget->rect.x,
+        - widget->rect.y);
+
+      switch ((MidRegionLayer) i)
         {
-          if ((i % 4) == 0)
-            {
-              zlfo_ui_theme_set_cr_color (
-                &self->ui_theme, self->cached_cr, grid_strong);
-            }
-          else
-            {
-              zlfo_ui_theme_set_cr_color (
-                &self->ui_theme, self->cached_cr, grid);
-            }
-          cairo_move_to (
-            self->cached_cr,
-            widget->rect.x + GRID_HPADDING +
-              i * GRID_SPACE,
-            widget->rect.y + GRID_YSTART_OFFSET);
-          cairo_line_to (
-            self->cached_cr,
-            widget->rect.x + GRID_HPADDING +
-              i * GRID_SPACE,
-            widget->rect.y + GRID_YEND_OFFSET);
-          cairo_stroke (self->cached_cr);
+        case LAYER_GRID:
+          draw_grid (self, layer_cr, widget);
+          break;
+        case LAYER_NODES:
+          draw_node_curves (self, layer_cr);
+          break;
+        default:
+          break;
         }
-      zlfo_ui_theme_set_cr_color (
-        &self->ui_theme, self->cached_cr, grid_strong);
-      cairo_move_to (
-        self->cached_cr,
-        GRID_XSTART_GLOBAL,
-        widget->rect.y + 105);
-      cairo_line_to (
-        self->cached_cr,
-        GRID_XEND_GLOBAL,
-        widget->rect.y + 105);
-      cairo_stroke (self->cached_cr);
+    }
+  self->dirty_layers = 0;
 
-      recalc_vars (
-        self->freerun,
-        &self->common.sine_multiplier,
-        &self->common.saw_multiplier,
-        &self->common.period_size,
-        NULL,
-        &self->common.host_pos, effective_freq,
-        sync_rate_float,
-        (float) self->common.samplerate);
+  for (int i = 0; i < NUM_LAYERS; i++)
+    {
+      if (!self->layer_surfaces[i])
+        continue;
 
-      /* draw other visible waves in the back */
-      draw_graph (self, self->cached_cr);
+      cairo_set_source_surface (
+        cr, self->layer_surfaces[i],
+        widget->rect.x, widget->rect.y);
+      cairo_paint (cr);
     }
 
-  cairo_set_source_surface (
-    cr, self->cached_surface, 0, 0);
-  cairo_paint (cr);
+  draw_scope (self, cr);
+  self->scope_changed = 0;
 
   /* draw current position */
-  double current_offset =
-    self->current_sample /
-    (double) self->common.period_size;
-
+  double playhead_x = get_playhead_x (self);
   cairo_set_source_rgba (cr, 1, 1, 1, 1);
+  cairo_set_line_width (cr, PLAYHEAD_LINE_WIDTH);
   cairo_move_to (
-    cr,
-    widget->rect.x + GRID_HPADDING +
-      current_offset * GRID_WIDTH,
+    cr, playhead_x,
     widget->rect.y + GRID_YSTART_OFFSET);
   cairo_line_to (
-    cr,
-    widget->rect.x + GRID_HPADDING +
-      current_offset * GRID_WIDTH,
+    cr, playhead_x,
     widget->rect.y + GRID_YEND_OFFSET);
   cairo_stroke (cr);
+  self->last_playhead_x = playhead_x;
+
+  draw_dsp_load (self, cr, widget);
+  self->dsp_load_changed = 0;
 
   self->has_change = 0;
 }
@@ -1962,8 +2505,8 @@ range_draw_cb (
     widget->rect.y,
     widget->rect.width,
     widget->rect.height };
-  ztk_rsvg_draw (
-    self->ui_theme.range_svg, cr, &rect);
+  zlfo_ui_theme_draw_svg (
+    &self->ui_theme, SVG_RANGE, cr, &rect);
 
   /* draw range */
   double width = RANGE_POINT_WIDTH;
@@ -2133,7 +2676,6 @@ add_range (
     self->app, (ZtkWidget *) da, 0);
 }
 
-#if 0
 static void
 zrythm_icon_draw_cb (
   ZtkWidget * widget,
@@ -2141,33 +2683,11 @@ zrythm_icon_draw_cb (
   ZtkRect *   draw_rect,
   ZLfoUi *    self)
 {
-  ZtkRect rect = {
-    widget->rect.x,
-    widget->rect.y,
-    widget->rect.width,
-    widget->rect.height };
-  ZtkWidgetState state = widget->state;
-  if (state & ZTK_WIDGET_STATE_PRESSED)
-    {
-      zlfo_ui_theme_set_cr_color (cr, button_hover);
-      ztk_rsvg_draw (
-        zlfo_ui_theme.zrythm_orange_svg, cr, &rect);
-    }
-  else if (state & ZTK_WIDGET_STATE_HOVERED)
-    {
-      zlfo_ui_theme_set_cr_color (cr, button_hover);
-      ztk_rsvg_draw (
-        zlfo_ui_theme.zrythm_hover_svg, cr, &rect);
-    }
-  else
-    {
-      zlfo_ui_theme_set_cr_color (
-        cr, button_normal);
-      ztk_rsvg_draw (
-        zlfo_ui_theme.zrythm_svg, cr, &rect);
-    }
+  draw_svged_button (
+    self, widget, cr, 0, NULL, NULL, NULL,
+    SVG_ZRYTHM, SVG_ZRYTHM_HOVER,
+    SVG_ZRYTHM_ORANGE, 0, 0);
 }
-#endif
 
 static void
 on_zrythm_btn_clicked (
@@ -2207,11 +2727,10 @@ add_zrythm_icon (
       &rect,
       (ZtkWidgetActivateCallback)
       on_zrythm_btn_clicked, self);
-  ztk_button_make_svged (
-    btn, 0, 0,
-    self->ui_theme.zrythm_svg,
-    self->ui_theme.zrythm_hover_svg,
-    self->ui_theme.zrythm_orange_svg);
+  ztk_button_add_background_callback (
+    btn,
+    (ZtkWidgetDrawCallback)
+    zrythm_icon_draw_cb);
   ztk_app_add_widget (
     self->app, (ZtkWidget *) btn, 0);
 }
@@ -2334,7 +2853,7 @@ grid_lbl_draw_cb (
   ZLfoUi * self = data->zlfo_ui;
 
   /* draw svgs */
-#define DRAW_SVG(caps,lowercase) \
+#define DRAW_SVG(caps) \
   case LBL_TYPE_##caps: \
     { \
       ZtkRect rect = { \
@@ -2342,16 +2861,17 @@ grid_lbl_draw_cb (
         widget->rect.y, \
         widget->rect.width, \
         widget->rect.height }; \
-      ztk_rsvg_draw ( \
-        self->ui_theme.lowercase##_svg, \
+      zlfo_ui_theme_draw_svg ( \
+        &self->ui_theme, \
+        SVG_##caps, \
         cr, &rect); \
     } \
     break
 
   switch (data->val)
     {
-      DRAW_SVG (INVERT, invert);
-      DRAW_SVG (SHIFT, shift);
+      DRAW_SVG (INVERT);
+      DRAW_SVG (SHIFT);
     default:
       break;
     }
@@ -2359,6 +2879,39 @@ grid_lbl_draw_cb (
 #undef DRAW_SVG
 }
 
+static void
+grid_btn_bg_cb (
+  ZtkWidget * w,
+  cairo_t *   cr,
+  ZtkRect *   draw_rect,
+  DrawData *  data)
+{
+  ZLfoUi * self = data->zlfo_ui;
+  ZLfoUiTheme * theme = &self->ui_theme;
+
+#define DRAW_BTN(caps,svg) \
+  case GRID_BTN_##caps: \
+    draw_svged_button ( \
+      self, w, cr, \
+      get_button_active ((ZtkButton *) w, data), \
+      &theme->bg, &theme->button_hover, \
+      &theme->left_button_click, \
+      SVG_##svg, SVG_##svg##_HOVER, \
+      SVG_##svg##_CLICK, 0, 0); \
+    break
+
+  switch (data->val)
+    {
+      DRAW_BTN (HMIRROR, HMIRROR);
+      DRAW_BTN (VMIRROR, VMIRROR);
+      DRAW_BTN (SNAP, GRID_SNAP);
+    default:
+      break;
+    }
+
+#undef DRAW_BTN
+}
+
 static void
 add_grid_controls (
   ZLfoUi * self)
@@ -2404,35 +2957,10 @@ add_grid_controls (
           &rect,
           (ZtkWidgetActivateCallback)
           on_btn_clicked, data);
-      ztk_button_set_background_colors (
+      ztk_button_add_background_callback (
         btn,
-        &self->ui_theme.bg,
-        &self->ui_theme.button_hover,
-        &self->ui_theme.left_button_click);
-      switch (i)
-        {
-        case GRID_BTN_HMIRROR:
-          ztk_button_make_svged (
-            btn, 0, 0,
-            self->ui_theme.hmirror_svg,
-            self->ui_theme.hmirror_hover_svg,
-            self->ui_theme.hmirror_click_svg);
-          break;
-        case GRID_BTN_VMIRROR:
-          ztk_button_make_svged (
-            btn, 0, 0,
-            self->ui_theme.vmirror_svg,
-            self->ui_theme.vmirror_hover_svg,
-            self->ui_theme.vmirror_click_svg);
-          break;
-        case GRID_BTN_SNAP:
-          ztk_button_make_svged (
-            btn, 0, 0,
-            self->ui_theme.grid_snap_svg,
-            self->ui_theme.grid_snap_hover_svg,
-            self->ui_theme.grid_snap_click_svg);
-          break;
-        }
+        (ZtkWidgetDrawCallback)
+        grid_btn_bg_cb);
       ztk_button_make_toggled (
         btn,
         (ZtkButtonToggledGetter)
@@ -2494,6 +3022,45 @@ add_grid_controls (
     }
 }
 
+/**
+ * Sets up the elements of the popup menus.
+ */
+static void
+init_combo_box_elements (
+  ZLfoUi * self)
+{
+  static const char * grid_step_labels[] = {
+    [GRID_STEP_FULL] = "full",
+    [GRID_STEP_HALF] = "1/2",
+    [GRID_STEP_FOURTH] = "1/4",
+    [GRID_STEP_EIGHTH] = "1/8",
+    [GRID_STEP_SIXTEENTH] = "1/16",
+    [GRID_STEP_THIRTY_SECOND] = "1/32",
+  };
+  for (int i = 0; i < NUM_GRID_STEPS; i++)
+    {
+      ComboBoxElement * el =
+        &self->grid_step_elements[i];
+      el->id = i;
+      el->label = grid_step_labels[i];
+      el->zlfo_ui = self;
+    }
+
+  static const char * sync_rate_type_labels[] = {
+    [SYNC_TYPE_NORMAL] = "normal",
+    [SYNC_TYPE_DOTTED] = "dotted",
+    [SYNC_TYPE_TRIPLET] = "triplet",
+  };
+  for (int i = 0; i < NUM_SYNC_RATE_TYPES; i++)
+    {
+      ComboBoxElement * el =
+        &self->sync_rate_type_elements[i];
+      el->id = i;
+      el->label = sync_rate_type_labels[i];
+      el->zlfo_ui = self;
+    }
+}
+
 static void
 create_ui (
   ZLfoUi * self)
@@ -2510,6 +3077,8 @@ create_ui (
   zlfo_ui_theme_init (
     &self->ui_theme, self->bundle_path);
 
+  init_combo_box_elements (self);
+
   /** add each control */
   add_bg_widget (self);
   add_left_buttons (self);
@@ -2536,9 +3105,13 @@ instantiate (
   self->write = write_function;
   self->controller = controller;
   self->dragging_node = -1;
+  self->visible = 1;
   self->has_change = 1;
+  self->dirty_layers = ALL_LAYERS;
   strcpy (self->bundle_path, bundle_path);
 
+  zlfo_tables_init ();
+
 #ifndef RELEASE
   ztk_log_set_level (ZTK_LOG_LEVEL_DEBUG);
 #endif
@@ -2584,6 +3157,12 @@ instantiate (
   lv2_atom_forge_init (
     &self->common.forge, self->common.map);
 
+  g_mutex_init (&self->preview_mutex);
+  g_cond_init (&self->preview_cond);
+  self->preview_thread =
+    g_thread_new (
+      "zlfo-preview", preview_worker, self);
+
   /* create UI and set the native window to the
    * widget */
   create_ui (self);
@@ -2637,9 +3216,73 @@ cleanup (LV2UI_Handle handle)
 
   ztk_app_free (self->app);
 
+  /* stop the preview worker */
+  g_mutex_lock (&self->preview_mutex);
+  self->preview_quit = 1;
+  g_cond_signal (&self->preview_cond);
+  g_mutex_unlock (&self->preview_mutex);
+  g_thread_join (self->preview_thread);
+  if (self->preview_result)
+    cairo_surface_destroy (self->preview_result);
+  g_cond_clear (&self->preview_cond);
+  g_mutex_clear (&self->preview_mutex);
+
+  for (int i = 0; i < NUM_LAYERS; i++)
+    {
+      if (self->layer_crs[i])
+        cairo_destroy (self->layer_crs[i]);
+      if (self->layer_surfaces[i])
+        cairo_surface_destroy (
+          self->layer_surfaces[i]);
+    }
+  zlfo_ui_theme_cleanup (&self->ui_theme);
+
   free (self);
 }
 
+/**
+ * Returns the layers of the mid region that
+ * depend on the given control port, as
+ * LAYER_BIT() flags.
+ */
+static int
+get_port_layers (
+  uint32_t port_index)
+{
+  if (port_index >= ZLFO_NODE_1_POS &&
+      port_index <= ZLFO_NODE_16_CURVE)
+    {
+      return
+        LAYER_BIT (LAYER_WAVES) |
+        LAYER_BIT (LAYER_NODES);
+    }
+
+  switch (port_index)
+    {
+    case ZLFO_SHIFT:
+    case ZLFO_RANGE_MIN:
+    case ZLFO_RANGE_MAX:
+    case ZLFO_STEP_MODE:
+    case ZLFO_GRID_STEP:
+    case ZLFO_HINVERT:
+    case ZLFO_VINVERT:
+    case ZLFO_SINE_TOGGLE:
+    case ZLFO_SAW_TOGGLE:
+    case ZLFO_SQUARE_TOGGLE:
+    case ZLFO_TRIANGLE_TOGGLE:
+      return LAYER_BIT (LAYER_WAVES);
+    case ZLFO_CUSTOM_TOGGLE:
+    case ZLFO_NUM_NODES:
+      return
+        LAYER_BIT (LAYER_WAVES) |
+        LAYER_BIT (LAYER_NODES);
+    default:
+      break;
+    }
+
+  return 0;
+}
+
 /**
  * Port event from the plugin.
  */
@@ -2661,93 +3304,103 @@ port_event (
    */
   if (format == 0)
     {
+      int changed = 0;
+#define SET_IF_CHANGED(field,val) \
+  if (!math_doubles_equal ( \
+         (double) self->field, (double) (val))) \
+    { \
+      self->field = val; \
+      changed = 1; \
+    }
+
       switch (port_index)
         {
         case ZLFO_FREQ:
-          self->freq = * (const float *) buffer;
+          SET_IF_CHANGED (
+            freq, * (const float *) buffer);
           break;
         case ZLFO_CV_GATE:
-          self->cv_gate =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            cv_gate, * (const float *) buffer);
           break;
         case ZLFO_CV_TRIGGER:
-          self->cv_trigger =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            cv_trigger, * (const float *) buffer);
           break;
         case ZLFO_GATE:
-          self->gate =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            gate, * (const float *) buffer);
           break;
         case ZLFO_TRIGGER:
-          self->trigger =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            trigger, (int) * (const float *) buffer);
           break;
         case ZLFO_SHIFT:
-          self->shift = * (const float *) buffer;
+          SET_IF_CHANGED (
+            shift, * (const float *) buffer);
           break;
         case ZLFO_RANGE_MIN:
-          self->range_min =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            range_min, * (const float *) buffer);
           break;
         case ZLFO_RANGE_MAX:
-          self->range_max =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            range_max, * (const float *) buffer);
           break;
         case ZLFO_STEP_MODE:
-          self->step_mode =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            step_mode, (int) * (const float *) buffer);
           break;
         case ZLFO_FREE_RUNNING:
-          self->freerun =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            freerun, (int) * (const float *) buffer);
           break;
         case ZLFO_GRID_STEP:
-          self->grid_step =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            grid_step, (int) * (const float *) buffer);
           break;
         case ZLFO_SYNC_RATE:
-          self->sync_rate =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            sync_rate, * (const float *) buffer);
           break;
         case ZLFO_SYNC_RATE_TYPE:
-          self->sync_rate_type =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            sync_rate_type, * (const float *) buffer);
           break;
         case ZLFO_HINVERT:
-          self->hinvert =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            hinvert, (int) * (const float *) buffer);
           break;
         case ZLFO_VINVERT:
-          self->vinvert =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            vinvert, (int) * (const float *) buffer);
           break;
         case ZLFO_SINE_TOGGLE:
-          self->sine_on =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            sine_on, (int) * (const float *) buffer);
           break;
         case ZLFO_SAW_TOGGLE:
-          self->saw_on =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            saw_on, (int) * (const float *) buffer);
           break;
         case ZLFO_SQUARE_TOGGLE:
-          self->square_on =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            square_on, (int) * (const float *) buffer);
           break;
         case ZLFO_TRIANGLE_TOGGLE:
-          self->triangle_on =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            triangle_on, (int) * (const float *) buffer);
           break;
         case ZLFO_CUSTOM_TOGGLE:
-          self->custom_on =
-            (int) * (const float *) buffer;
+          SET_IF_CHANGED (
+            custom_on, (int) * (const float *) buffer);
           break;
         case ZLFO_NUM_NODES:
-          self->num_nodes =
-            (int) * (const float *) buffer;
-          break;
-        case ZLFO_SAMPLE_TO_UI:
-          self->current_sample =
-            (double) * (const float *) buffer;
+          SET_IF_CHANGED (
+            num_nodes,
+            CLAMP (
+              (int) * (const float *) buffer, 1, 16));
+          self->sent_num_nodes = self->num_nodes;
           break;
         default:
           break;
@@ -2760,14 +3413,24 @@ port_event (
             (port_index - ZLFO_NODE_1_POS) % 3;
           unsigned int node_id =
             (port_index - ZLFO_NODE_1_POS) / 3;
-          self->nodes[node_id][prop] =
-            * (const float *) buffer;
+          SET_IF_CHANGED (
+            nodes[node_id][prop],
+            * (const float *) buffer);
+          self->sent_nodes[node_id][prop] =
+            self->nodes[node_id][prop];
         }
-      /*puglPostRedisplay (self->app->view);*/
 
-      if (port_index != ZLFO_SAMPLE_TO_UI)
+#undef SET_IF_CHANGED
+
+      /* hosts send every control port on any
+       * change, and the outputs and the ports the
+       * UI does not show never change anything
+       * here, so only redraw what the new value
+       * affects */
+      if (changed)
         {
-          self->has_change = 1;
+          mark_dirty (
+            self, get_port_layers (port_index));
         }
     }
   else if (format ==
@@ -2856,12 +3519,72 @@ port_event (
                 &self->common.host_pos,
                 &self->common.uris, obj);
             }
+          else if (obj->body.otype ==
+                     self->common.uris.playhead)
+            {
+              Playhead playhead;
+              if (update_playhead_from_atom_obj (
+                    &playhead, &self->common.uris,
+                    obj))
+                {
+                  ztk_warning (
+                    "failed to read playhead atom");
+                }
+              else
+                {
+                  self->common.current_sample =
+                    (long) playhead.current_sample;
+                  self->common.period_size =
+                    (long) playhead.period_size;
+                  self->current_sample =
+                    (double) playhead.current_sample;
 
-          self->has_change = 1;
+                  /* interpolate from here until the
+                   * next update */
+                  self->last_current_sample_set =
+                    g_get_monotonic_time ();
+                }
+            }
+          else if (obj->body.otype ==
+                     self->common.uris.scope)
+            {
+              const float * columns;
+              int num_columns =
+                get_scope_columns_from_atom_obj (
+                  &self->common.uris, obj,
+                  &columns);
+              for (int i = 0; i < num_columns; i++)
+                {
+                  memcpy (
+                    self->scope[self->scope_pos],
+                    &columns[i * NUM_WAVEFORMS * 2],
+                    sizeof (self->scope[0]));
+                  self->scope_pos =
+                    (self->scope_pos + 1) %
+                    SCOPE_SIZE;
+                }
+              if (num_columns > 0)
+                {
+                  self->scope_num_columns =
+                    MIN (
+                      self->scope_num_columns +
+                        num_columns,
+                      SCOPE_SIZE);
+                  self->scope_changed = 1;
+                }
+            }
+          else if (obj->body.otype ==
+                     self->common.uris.dsp_load)
+            {
+              update_dsp_load_from_atom_obj (
+                &self->dsp_load,
+                &self->common.uris, obj);
+              self->dsp_load_changed = 1;
+            }
 
-/*#if 0*/
-          /*redraw_mid_region (self);*/
-/*#endif*/
+          /* the UI state and the position only
+           * move the playhead, which is redrawn
+           * in ui_idle() */
         }
       else
         {
@@ -2889,6 +3612,14 @@ ui_show (LV2UI_Handle handle)
   printf ("show called\n");
   ZLfoUi * self = (ZLfoUi *) handle;
   ztk_app_show_window (self->app);
+
+  /* nothing was drawn while hidden, and the
+   * playhead must be set again from the current
+   * time */
+  self->visible = 1;
+  self->last_current_sample_set = 0;
+  mark_dirty (self, ALL_LAYERS);
+
   return 0;
 }
 
@@ -2899,6 +3630,7 @@ ui_hide (LV2UI_Handle handle)
   printf ("hide called\n");
   ZLfoUi * self = (ZLfoUi *) handle;
   ztk_app_hide_window (self->app);
+  self->visible = 0;
 
   return 0;
 }
@@ -2906,6 +3638,12 @@ ui_hide (LV2UI_Handle handle)
 /**
  * LV2 idle interface for optional non-embedded
  * UI.
+ *
+ * Events are always handled, but redraws are only
+ * posted while the window is shown, at most
+ * MAX_FPS times per second. redraw_mid_region()
+ * posts nothing if the playhead did not move and
+ * nothing else changed.
  */
 static int
 ui_idle (LV2UI_Handle handle)
@@ -2913,6 +3651,18 @@ ui_idle (LV2UI_Handle handle)
   ZLfoUi * self = (ZLfoUi *) handle;
 
   ztk_app_idle (self->app);
+  flush_node_edits (self);
+
+  if (!self->visible)
+    return 0;
+
+  gint64 cur_time = g_get_monotonic_time ();
+  if (cur_time - self->last_redraw_time <
+        1000000 / MAX_FPS)
+    return 0;
+  self->last_redraw_time = cur_time;
+
+  update_current_sample (self);
   redraw_mid_region (self);
 
   return 0;
@@ -19,9 +19,147 @@
 
 #include "config.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <ztoolkit/ztk.h>
 
 #include <glib.h>
+#include <glib-object.h>
+
+/**
+ * SVGs in the resources directory.
+ *
+ * The ones before SVG_FIRST_LAZY are visible when
+ * the UI opens and are loaded with the theme. The
+ * rest (hover and click states, unused variants)
+ * are loaded the first time they are drawn.
+ */
+typedef enum ZLfoSvg
+{
+  SVG_SINE,
+  SVG_TRIANGLE,
+  SVG_SAW,
+  SVG_SQUARE,
+  SVG_CUSTOM,
+  SVG_CURVE,
+  SVG_STEP,
+  SVG_RANGE,
+  SVG_SYNC,
+  SVG_FREEB,
+  SVG_ZRYTHM,
+  SVG_GRID_SNAP,
+  SVG_HMIRROR,
+  SVG_VMIRROR,
+  SVG_INVERT,
+  SVG_SHIFT,
+  SVG_DOWN_ARROW,
+  SVG_FIRST_LAZY,
+  SVG_CURVE_ACTIVE = SVG_FIRST_LAZY,
+  SVG_STEP_ACTIVE,
+  SVG_SYNC_BLACK,
+  SVG_FREEB_BLACK,
+  SVG_ZRYTHM_HOVER,
+  SVG_ZRYTHM_ORANGE,
+  SVG_GRID_SNAP_HOVER,
+  SVG_GRID_SNAP_CLICK,
+  SVG_HMIRROR_HOVER,
+  SVG_HMIRROR_CLICK,
+  SVG_VMIRROR_HOVER,
+  SVG_VMIRROR_CLICK,
+  NUM_SVGS,
+} ZLfoSvg;
+
+/** File names without the extension, indexed by
+ * ZLfoSvg. */
+static const char * zlfo_svg_names[NUM_SVGS] = {
+  "sine", "triangle", "saw", "square", "custom",
+  "curve", "step", "range", "sync", "freeb",
+  "zrythm", "grid_snap", "hmirror", "vmirror",
+  "invert", "shift", "down_arrow",
+  "curve_active", "step_active", "sync_black",
+  "freeb_black", "zrythm_hover", "zrythm_orange",
+  "grid_snap_hover", "grid_snap_click",
+  "hmirror_hover", "hmirror_click",
+  "vmirror_hover", "vmirror_click",
+};
+
+/**
+ * SVGs parsed once per bundle path and shared by
+ * all the UIs in the process.
+ *
+ * The list and the handles are protected by
+ * zlfo_ui_theme_svgs_lock.
+ */
+typedef struct ZLfoUiThemeSvgs
+{
+  char *          bundle_path;
+
+  /** Number of themes using this. */
+  int             refcount;
+
+  /** Parsed SVGs, or NULL if not loaded yet. */
+  ZtkRsvgHandle * handles[NUM_SVGS];
+
+  struct ZLfoUiThemeSvgs * next;
+} ZLfoUiThemeSvgs;
+
+static ZLfoUiThemeSvgs * zlfo_ui_theme_svgs_list;
+
+/** Guards the list and the handles, which are
+ * shared by the UIs and must not be rendered from
+ * two threads at once. */
+G_LOCK_DEFINE_STATIC (zlfo_ui_theme_svgs_lock);
+
+/** Size of the icon atlas surface, in pixels. */
+#define ICON_ATLAS_WIDTH 512
+#define ICON_ATLAS_HEIGHT 512
+
+/** Max number of rasterized icons. */
+#define ICON_ATLAS_MAX_ENTRIES 64
+
+/**
+ * An SVG rasterized at a given size in the icon
+ * atlas.
+ */
+typedef struct ZLfoIconAtlasEntry
+{
+  ZLfoSvg         svg;
+
+  /** Position and size in the atlas, in
+   * pixels. */
+  int             x;
+  int             y;
+  int             width;
+  int             height;
+} ZLfoIconAtlasEntry;
+
+/**
+ * Surface holding every icon rasterized once,
+ * packed in rows (shelves) from the top left.
+ *
+ * Draw callbacks blit from here instead of
+ * rendering the SVGs on every repaint.
+ */
+typedef struct ZLfoIconAtlas
+{
+  /** Created on the first draw, similar to the
+   * window surface. */
+  cairo_surface_t *  surface;
+
+  ZLfoIconAtlasEntry entries[ICON_ATLAS_MAX_ENTRIES];
+  int                num_entries;
+
+  /** Position for the next icon in the current
+   * shelf. */
+  int                shelf_x;
+  int                shelf_y;
+
+  /** Height of the tallest icon in the current
+   * shelf. */
+  int                shelf_height;
+} ZLfoIconAtlas;
 
 /**
  * Theme for the ZLFO UI.
@@ -65,43 +203,56 @@ typedef struct ZLfoUiTheme
   ZtkColor button_lining_active;
   ZtkColor button_lining_hover;
 
-  ZtkRsvgHandle * sine_svg;
-  ZtkRsvgHandle * saw_svg;
-  ZtkRsvgHandle * triangle_svg;
-  ZtkRsvgHandle * square_svg;
-  ZtkRsvgHandle * custom_svg;
-  ZtkRsvgHandle * curve_svg;
-  ZtkRsvgHandle * step_svg;
-  ZtkRsvgHandle * curve_active_svg;
-  ZtkRsvgHandle * step_active_svg;
-
-  ZtkRsvgHandle * range_svg;
-
-  ZtkRsvgHandle * sync_svg;
-  ZtkRsvgHandle * freeb_svg;
-  ZtkRsvgHandle * sync_black_svg;
-  ZtkRsvgHandle * freeb_black_svg;
-
-  ZtkRsvgHandle * zrythm_svg;
-  ZtkRsvgHandle * zrythm_hover_svg;
-  ZtkRsvgHandle * zrythm_orange_svg;
-
-  ZtkRsvgHandle * grid_snap_svg;
-  ZtkRsvgHandle * grid_snap_hover_svg;
-  ZtkRsvgHandle * grid_snap_click_svg;
-  ZtkRsvgHandle * hmirror_svg;
-  ZtkRsvgHandle * hmirror_hover_svg;
-  ZtkRsvgHandle * hmirror_click_svg;
-  ZtkRsvgHandle * vmirror_svg;
-  ZtkRsvgHandle * vmirror_hover_svg;
-  ZtkRsvgHandle * vmirror_click_svg;
-  ZtkRsvgHandle * invert_svg;
-  ZtkRsvgHandle * shift_svg;
-
-  ZtkRsvgHandle * down_arrow_svg;
+  /** Shared SVGs. */
+  ZLfoUiThemeSvgs * svgs;
+
+  /** Rasterized SVGs. */
+  ZLfoIconAtlas     icon_atlas;
 
 } ZLfoUiTheme;
 
+/**
+ * Parses the SVG if it is not loaded yet.
+ *
+ * Must be called with zlfo_ui_theme_svgs_lock
+ * held.
+ */
+static inline ZtkRsvgHandle *
+zlfo_ui_theme_svgs_load (
+  ZLfoUiThemeSvgs * svgs,
+  ZLfoSvg           svg)
+{
+  if (svgs->handles[svg])
+    return svgs->handles[svg];
+
+  char * filename =
+    g_strdup_printf ("%s.svg", zlfo_svg_names[svg]);
+  char * abs_path =
+    g_build_filename (
+      svgs->bundle_path, "resources", filename,
+      NULL);
+  ZtkRsvgHandle * handle =
+    ztk_rsvg_load_svg (abs_path);
+  if (!handle)
+    {
+      ztk_error (
+        "Failed loading SVG: %s", abs_path);
+      exit (1);
+    }
+  g_free (filename);
+  g_free (abs_path);
+
+  g_atomic_pointer_set (
+    &svgs->handles[svg], handle);
+
+  return handle;
+}
+
+/**
+ * Sets up the colors and takes a reference to the
+ * SVGs of the bundle, parsing them if this is the
+ * first theme for this bundle in the process.
+ */
 static inline void
 zlfo_ui_theme_init (
   ZLfoUiTheme * theme,
@@ -126,50 +277,232 @@ zlfo_ui_theme_init (
   SET_COLOR (button_lining_active, "#2EB398");
   SET_COLOR (button_lining_hover, "#19664c");
 
-  char * abs_path;
-#define LOAD_SVG(name) \
-  abs_path = \
-    g_build_filename ( \
-      bundle_path, "resources", #name ".svg", \
-      NULL); \
-  theme->name##_svg = \
-    ztk_rsvg_load_svg (abs_path); \
-  if (!theme->name##_svg) \
-    { \
-      ztk_error ( \
-        "Failed loading SVG: %s", abs_path); \
-      exit (1); \
+  G_LOCK (zlfo_ui_theme_svgs_lock);
+  ZLfoUiThemeSvgs * svgs =
+    zlfo_ui_theme_svgs_list;
+  while (svgs &&
+         strcmp (svgs->bundle_path, bundle_path))
+    {
+      svgs = svgs->next;
+    }
+  if (!svgs)
+    {
+      svgs = calloc (1, sizeof (ZLfoUiThemeSvgs));
+      svgs->bundle_path = g_strdup (bundle_path);
+      for (int i = 0; i < SVG_FIRST_LAZY; i++)
+        {
+          zlfo_ui_theme_svgs_load (
+            svgs, (ZLfoSvg) i);
+        }
+      svgs->next = zlfo_ui_theme_svgs_list;
+      zlfo_ui_theme_svgs_list = svgs;
+    }
+  svgs->refcount++;
+  G_UNLOCK (zlfo_ui_theme_svgs_lock);
+
+  theme->svgs = svgs;
+}
+
+/**
+ * Frees the rasterized icons and drops the
+ * reference to the SVGs, freeing them if this was
+ * the last theme using them.
+ */
+static inline void
+zlfo_ui_theme_cleanup (
+  ZLfoUiTheme * theme)
+{
+  if (theme->icon_atlas.surface)
+    {
+      cairo_surface_destroy (
+        theme->icon_atlas.surface);
+      theme->icon_atlas.surface = NULL;
+    }
+  theme->icon_atlas.num_entries = 0;
+
+  ZLfoUiThemeSvgs * svgs = theme->svgs;
+  if (!svgs)
+    return;
+  theme->svgs = NULL;
+
+  G_LOCK (zlfo_ui_theme_svgs_lock);
+  if (--svgs->refcount == 0)
+    {
+      ZLfoUiThemeSvgs ** prev =
+        &zlfo_ui_theme_svgs_list;
+      while (*prev != svgs)
+        prev = &(*prev)->next;
+      *prev = svgs->next;
+
+      for (int i = 0; i < NUM_SVGS; i++)
+        {
+          if (svgs->handles[i])
+            g_object_unref (svgs->handles[i]);
+        }
+      g_free (svgs->bundle_path);
+      free (svgs);
+    }
+  G_UNLOCK (zlfo_ui_theme_svgs_lock);
+}
+
+/**
+ * Returns the SVG, parsing it if this is the first
+ * time it is needed.
+ */
+static inline ZtkRsvgHandle *
+zlfo_ui_theme_get_svg (
+  ZLfoUiTheme * theme,
+  ZLfoSvg       svg)
+{
+  ZtkRsvgHandle * handle =
+    g_atomic_pointer_get (
+      &theme->svgs->handles[svg]);
+  if (handle)
+    return handle;
+
+  G_LOCK (zlfo_ui_theme_svgs_lock);
+  handle =
+    zlfo_ui_theme_svgs_load (theme->svgs, svg);
+  G_UNLOCK (zlfo_ui_theme_svgs_lock);
+
+  return handle;
+}
+
+/**
+ * Renders the SVG in the given rectangle.
+ *
+ * The handles are shared between the UIs, so they
+ * are rendered with the lock held.
+ */
+static inline void
+zlfo_ui_theme_render_svg (
+  ZLfoUiTheme * theme,
+  ZLfoSvg       svg,
+  cairo_t *     cr,
+  ZtkRect *     rect)
+{
+  ZtkRsvgHandle * handle =
+    zlfo_ui_theme_get_svg (theme, svg);
+
+  G_LOCK (zlfo_ui_theme_svgs_lock);
+  ztk_rsvg_draw (handle, cr, rect);
+  G_UNLOCK (zlfo_ui_theme_svgs_lock);
+}
+
+/**
+ * Returns the atlas entry of the SVG at the given
+ * size, rasterizing it if it is not in the atlas
+ * yet, or NULL if the atlas is full.
+ */
+static inline ZLfoIconAtlasEntry *
+zlfo_ui_theme_get_icon (
+  ZLfoUiTheme *   theme,
+  ZLfoSvg         svg,
+  int             width,
+  int             height,
+  cairo_t *       cr)
+{
+  ZLfoIconAtlas * atlas = &theme->icon_atlas;
+  for (int i = 0; i < atlas->num_entries; i++)
+    {
+      ZLfoIconAtlasEntry * entry =
+        &atlas->entries[i];
+      if (entry->svg == svg &&
+          entry->width == width &&
+          entry->height == height)
+        return entry;
+    }
+
+  if (atlas->num_entries ==
+        ICON_ATLAS_MAX_ENTRIES ||
+      width > ICON_ATLAS_WIDTH)
+    return NULL;
+
+  /* start a new shelf if it doesn't fit in the
+   * current one */
+  if (atlas->shelf_x + width > ICON_ATLAS_WIDTH)
+    {
+      atlas->shelf_x = 0;
+      atlas->shelf_y += atlas->shelf_height;
+      atlas->shelf_height = 0;
+    }
+  if (atlas->shelf_y + height > ICON_ATLAS_HEIGHT)
+    return NULL;
+
+  if (!atlas->surface)
+    {
+      atlas->surface =
+        cairo_surface_create_similar (
+          cairo_get_target (cr),
+          CAIRO_CONTENT_COLOR_ALPHA,
+          ICON_ATLAS_WIDTH, ICON_ATLAS_HEIGHT);
+    }
+
+  ZLfoIconAtlasEntry * entry =
+    &atlas->entries[atlas->num_entries++];
+  entry->svg = svg;
+  entry->x = atlas->shelf_x;
+  entry->y = atlas->shelf_y;
+  entry->width = width;
+  entry->height = height;
+
+  atlas->shelf_x += width;
+  atlas->shelf_height =
+    MAX (atlas->shelf_height, height);
+
+  /* rasterize */
+  cairo_t * atlas_cr =
+    cairo_create (atlas->surface);
+  ZtkRect rect = {
+    entry->x, entry->y, width, height };
+  cairo_rectangle (
+    atlas_cr, rect.x, rect.y, rect.width,
+    rect.height);
+  cairo_clip (atlas_cr);
+  zlfo_ui_theme_render_svg (
+    theme, svg, atlas_cr, &rect);
+  cairo_destroy (atlas_cr);
+
+  return entry;
+}
+
+/**
+ * Draws the SVG in the given rectangle.
+ *
+ * The SVG is rasterized in the icon atlas the
+ * first time it is drawn at this size, and later
+ * draws only copy the pixels.
+ */
+static inline void
+zlfo_ui_theme_draw_svg (
+  ZLfoUiTheme *   theme,
+  ZLfoSvg         svg,
+  cairo_t *       cr,
+  ZtkRect *       rect)
+{
+  int width = (int) ceil (rect->width);
+  int height = (int) ceil (rect->height);
+  ZLfoIconAtlasEntry * entry =
+    zlfo_ui_theme_get_icon (
+      theme, svg, width, height, cr);
+  if (!entry)
+    {
+      zlfo_ui_theme_render_svg (
+        theme, svg, cr, rect);
+      return;
     }
 
-  LOAD_SVG (sine);
-  LOAD_SVG (triangle);
-  LOAD_SVG (saw);
-  LOAD_SVG (square);
-  LOAD_SVG (custom);
-  LOAD_SVG (curve);
-  LOAD_SVG (step);
-  LOAD_SVG (curve_active);
-  LOAD_SVG (step_active);
-  LOAD_SVG (range);
-  LOAD_SVG (sync);
-  LOAD_SVG (freeb);
-  LOAD_SVG (sync_black);
-  LOAD_SVG (freeb_black);
-  LOAD_SVG (zrythm);
-  LOAD_SVG (zrythm_hover);
-  LOAD_SVG (zrythm_orange);
-  LOAD_SVG (grid_snap);
-  LOAD_SVG (grid_snap_hover);
-  LOAD_SVG (grid_snap_click);
-  LOAD_SVG (hmirror);
-  LOAD_SVG (hmirror_hover);
-  LOAD_SVG (hmirror_click);
-  LOAD_SVG (vmirror);
-  LOAD_SVG (vmirror_hover);
-  LOAD_SVG (vmirror_click);
-  LOAD_SVG (invert);
-  LOAD_SVG (shift);
-  LOAD_SVG (down_arrow);
+  /* align to pixels so the copy is not
+   * filtered */
+  double x = round (rect->x);
+  double y = round (rect->y);
+  cairo_save (cr);
+  cairo_set_source_surface (
+    cr, theme->icon_atlas.surface,
+    x - entry->x, y - entry->y);
+  cairo_rectangle (cr, x, y, width, height);
+  cairo_fill (cr);
+  cairo_restore (cr);
 }
 
 /**
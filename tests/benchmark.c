@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Benchmark of run() across block sizes, waveforms,
+ * modes, node counts and gating.
+ *
+ * Results are printed as CSV, one line per
+ * combination, with the time per sample in
+ * nanoseconds and in CPU cycles (-1 if there is no
+ * cycle counter on this platform).
+ */
+
+#include "config.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+
+/** Samples to process per measurement. */
+#define SAMPLES_PER_RUN 65536
+
+/** Measurements per combination (the best one is
+ * reported). */
+#define NUM_REPEATS 3
+
+typedef enum Mode
+{
+  MODE_FREE,
+  MODE_STEP,
+  MODE_SYNC,
+  NUM_MODES,
+} Mode;
+
+static const char * mode_strs[NUM_MODES] = {
+  "free", "step", "sync", };
+
+static const uint32_t block_sizes[] = {
+  1, 16, 64, 256, 1024, 8192, };
+
+static const int node_counts[] = { 2, 8, 16, };
+
+/** Toggle ports, indexed by Waveform. */
+static const int toggles[NUM_WAVEFORMS] = {
+  ZLFO_SINE_TOGGLE, ZLFO_TRIANGLE_TOGGLE,
+  ZLFO_SAW_TOGGLE, ZLFO_SQUARE_TOGGLE,
+  ZLFO_CUSTOM_TOGGLE, };
+
+static const char * wave_strs[NUM_WAVEFORMS] = {
+  "sine", "triangle", "saw", "square", "custom", };
+
+static inline uint64_t
+get_cycles (void)
+{
+#ifdef HAVE_RDTSC
+  return __rdtsc ();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Runs one combination.
+ *
+ * @param wave Waveform to enable, or
+ *   NUM_WAVEFORMS for all of them.
+ */
+static void
+bench (
+  uint32_t block_size,
+  int      wave,
+  Mode     mode,
+  int      num_nodes,
+  int      gated)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, block_size))
+    exit (1);
+
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      host.controls[toggles[i]] =
+        (wave == i || wave == NUM_WAVEFORMS) ?
+          1.f : 0.f;
+    }
+  host.controls[ZLFO_STEP_MODE] =
+    mode == MODE_STEP ? 1.f : 0.f;
+  host.controls[ZLFO_FREE_RUNNING] =
+    mode == MODE_SYNC ? 0.f : 1.f;
+  host.controls[ZLFO_NUM_NODES] = (float) num_nodes;
+  for (int i = 0; i < num_nodes; i++)
+    {
+      host.controls[ZLFO_NODE_1_POS + i * 3] =
+        (float) i / (float) (num_nodes - 1);
+      host.controls[ZLFO_NODE_1_VAL + i * 3] =
+        (float) (i % 2);
+    }
+  host.controls[ZLFO_GATED_MODE] = (float) gated;
+
+  /* half of the samples have the gate open */
+  for (uint32_t i = 0; i < block_size; i++)
+    {
+      host.cv[ZLFO_CV_GATE][i] =
+        (i % 2) ? 1.f : 0.f;
+    }
+
+  if (mode == MODE_SYNC)
+    {
+      host_send_position (
+        &host, 0, 0, 120.f, 4, 1.f);
+    }
+
+  /* warm up */
+  host_run (&host, block_size);
+
+  uint32_t num_blocks =
+    MAX (SAMPLES_PER_RUN / block_size, 1);
+  double n_samples =
+    (double) num_blocks * (double) block_size;
+  double best_ns = 0.0;
+  double best_cycles = 0.0;
+  for (int i = 0; i < NUM_REPEATS; i++)
+    {
+      double start = host_get_time_ns ();
+      uint64_t start_cycles = get_cycles ();
+      for (uint32_t j = 0; j < num_blocks; j++)
+        {
+          host_run (&host, block_size);
+        }
+      double ns =
+        (host_get_time_ns () - start) / n_samples;
+      double cycles =
+        (double) (get_cycles () - start_cycles) /
+        n_samples;
+      if (i == 0 || ns < best_ns)
+        {
+          best_ns = ns;
+          best_cycles = cycles;
+        }
+    }
+
+  host_cleanup (&host);
+
+#ifndef HAVE_RDTSC
+  best_cycles = -1.0;
+#endif
+
+  printf (
+    "%u,%s,%s,%d,%d,%.3f,%.2f\n",
+    block_size,
+    wave == NUM_WAVEFORMS ? "all" : wave_strs[wave],
+    mode_strs[mode], num_nodes, gated,
+    best_ns, best_cycles);
+  fflush (stdout);
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  printf (
+    "block_size,waveform,mode,nodes,gated,"
+    "ns_per_sample,cycles_per_sample\n");
+
+  for (size_t i = 0;
+       i < sizeof (block_sizes) / sizeof (uint32_t);
+       i++)
+    {
+      for (int wave = 0; wave <= NUM_WAVEFORMS;
+           wave++)
+        {
+          for (int mode = 0; mode < NUM_MODES;
+               mode++)
+            {
+              for (size_t j = 0;
+                   j < sizeof (node_counts) /
+                         sizeof (int);
+                   j++)
+                {
+                  /* node count only affects the
+                   * custom waveform */
+                  if (j > 0 &&
+                      wave != WAVEFORM_CUSTOM &&
+                      wave != NUM_WAVEFORMS)
+                    continue;
+
+                  for (int gated = 0; gated < 2;
+                       gated++)
+                    {
+                      bench (
+                        block_sizes[i], wave,
+                        (Mode) mode, node_counts[j],
+                        gated);
+                    }
+                }
+            }
+        }
+    }
+
+  return 0;
+}
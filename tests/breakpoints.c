@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that linear interpolation between the
+ * breakpoints reproduces the CV outputs within the
+ * tolerance.
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include "lv2_host.h"
+
+#include "lv2/atom/util.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 400
+#define TOLERANCE 0.001f
+
+/** Last breakpoint received for each waveform. */
+typedef struct LastBreakpoint
+{
+  int    valid;
+  long   frame;
+  float  value;
+  float  slope;
+} LastBreakpoint;
+
+static int
+get_cv_port (
+  int wave)
+{
+  static const int ports[NUM_WAVEFORMS] = {
+    ZLFO_SINE_OUT, ZLFO_TRIANGLE_OUT,
+    ZLFO_SAW_OUT, ZLFO_SQUARE_OUT,
+    ZLFO_CUSTOM_OUT, };
+  return ports[wave];
+}
+
+/**
+ * Runs the plugin and checks the reconstruction.
+ *
+ * @return The number of breakpoints received, or
+ *   -1 if the reconstruction failed.
+ */
+static long
+check (
+  float freq,
+  int   step_mode)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    exit (1);
+
+  LV2_URID breakpoint =
+    host_map_uri (
+      &host.urid_map, LFO_URI "#breakpoint");
+  LV2_URID breakpoint_waveform =
+    host_map_uri (
+      &host.urid_map,
+      LFO_URI "#breakpoint_waveform");
+  LV2_URID breakpoint_value =
+    host_map_uri (
+      &host.urid_map, LFO_URI "#breakpoint_value");
+  LV2_URID breakpoint_slope =
+    host_map_uri (
+      &host.urid_map, LFO_URI "#breakpoint_slope");
+
+  host.controls[ZLFO_FREQ] = freq;
+  host.controls[ZLFO_STEP_MODE] = step_mode;
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SAW_TOGGLE] = 1.f;
+  host.controls[ZLFO_TRIANGLE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SQUARE_TOGGLE] = 1.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  host.controls[ZLFO_BREAKPOINTS_TOGGLE] = 1.f;
+  host.controls[ZLFO_BREAKPOINTS_TOLERANCE] =
+    TOLERANCE;
+
+  LastBreakpoint last[NUM_WAVEFORMS];
+  memset (last, 0, sizeof (last));
+  long num_breakpoints = 0;
+  long offset = 0;
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      host_run (&host, BLOCK_SIZE);
+
+      LV2_Atom_Sequence * seq =
+        host.atoms[ZLFO_BREAKPOINTS_OUT];
+      LV2_Atom_Event * ev =
+        lv2_atom_sequence_begin (&seq->body);
+      for (int k = 0; k < BLOCK_SIZE; k++)
+        {
+          /* apply the breakpoints at this frame */
+          while (
+            !lv2_atom_sequence_is_end (
+              &seq->body, seq->atom.size, ev) &&
+            ev->time.frames <= k)
+            {
+              const LV2_Atom_Object * obj =
+                (const LV2_Atom_Object *) &ev->body;
+              const LV2_Atom * wave = NULL;
+              const LV2_Atom * value = NULL;
+              const LV2_Atom * slope = NULL;
+              if (obj->body.otype == breakpoint)
+                {
+                  lv2_atom_object_get (
+                    obj, breakpoint_waveform, &wave,
+                    breakpoint_value, &value,
+                    breakpoint_slope, &slope, NULL);
+                }
+              if (!wave || !value || !slope ||
+                  ev->time.frames < k)
+                {
+                  fprintf (
+                    stderr,
+                    "Invalid breakpoint at frame "
+                    "%ld\n", offset + k);
+                  return -1;
+                }
+
+              LastBreakpoint * bp =
+                &last[
+                  ((const LV2_Atom_Int *) wave)->body];
+              bp->valid = 1;
+              bp->frame = offset + k;
+              bp->value =
+                ((const LV2_Atom_Float *) value)->body;
+              bp->slope =
+                ((const LV2_Atom_Float *) slope)->body;
+              num_breakpoints++;
+
+              ev = lv2_atom_sequence_next (ev);
+            }
+
+          for (int j = 0; j < NUM_WAVEFORMS; j++)
+            {
+              const float * buf =
+                host.cv[get_cv_port (j)];
+              LastBreakpoint * bp = &last[j];
+              if (!bp->valid)
+                {
+                  fprintf (
+                    stderr, "No breakpoint for %d\n",
+                    j);
+                  return -1;
+                }
+
+              float val =
+                bp->value +
+                bp->slope *
+                  (float) (offset + k - bp->frame);
+              if (fabsf (val - buf[k]) >
+                    TOLERANCE * 1.01f + 1e-6f)
+                {
+                  fprintf (
+                    stderr,
+                    "Waveform %d at frame %ld: "
+                    "expected %f, got %f\n",
+                    j, offset + k, (double) buf[k],
+                    (double) val);
+                  return -1;
+                }
+            }
+        }
+      if (!lv2_atom_sequence_is_end (
+             &seq->body, seq->atom.size, ev))
+        {
+          fprintf (stderr, "Breakpoint past block\n");
+          return -1;
+        }
+
+      offset += BLOCK_SIZE;
+    }
+
+  host_cleanup (&host);
+
+  return num_breakpoints;
+}
+
+/** Block size and tolerance that make the sine
+ * need a breakpoint at almost every sample, so
+ * that there are more breakpoints than fit in a
+ * cycle. */
+#define OVERFLOW_BLOCK_SIZE 4096
+#define OVERFLOW_TOLERANCE 0.00001f
+
+/** Normal blocks run after each overflowing
+ * one. */
+#define BLOCKS_AFTER_OVERFLOW 4
+
+/**
+ * Checks that when the breakpoints do not fit in a
+ * cycle, the reconstruction stays within the
+ * tolerance up to the last breakpoint of each
+ * waveform, and over the whole of the next
+ * cycles.
+ *
+ * @return 0 if successful.
+ */
+static int
+check_overflow (void)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, OVERFLOW_BLOCK_SIZE))
+    exit (1);
+
+  LV2_URID breakpoint_waveform =
+    host_map_uri (
+      &host.urid_map,
+      LFO_URI "#breakpoint_waveform");
+  LV2_URID breakpoint_value =
+    host_map_uri (
+      &host.urid_map, LFO_URI "#breakpoint_value");
+  LV2_URID breakpoint_slope =
+    host_map_uri (
+      &host.urid_map, LFO_URI "#breakpoint_slope");
+
+  host.controls[ZLFO_FREQ] = MAX_FREQ;
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SAW_TOGGLE] = 1.f;
+  host.controls[ZLFO_TRIANGLE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SQUARE_TOGGLE] = 1.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  host.controls[ZLFO_BREAKPOINTS_TOGGLE] = 1.f;
+
+  /* each waveform gets an equal share */
+  const int max_breakpoints =
+    MAX_BREAKPOINTS / NUM_WAVEFORMS;
+
+  LastBreakpoint last[NUM_WAVEFORMS];
+  memset (last, 0, sizeof (last));
+  long offset = 0;
+  int num_overflows = 0;
+  for (int i = 0;
+       i < 4 * (BLOCKS_AFTER_OVERFLOW + 1); i++)
+    {
+      int overflow =
+        i % (BLOCKS_AFTER_OVERFLOW + 1) == 0;
+      uint32_t n_samples =
+        overflow ? OVERFLOW_BLOCK_SIZE : BLOCK_SIZE;
+      float tolerance =
+        overflow ? OVERFLOW_TOLERANCE : TOLERANCE;
+      host.controls[ZLFO_BREAKPOINTS_TOLERANCE] =
+        tolerance;
+      host_run (&host, n_samples);
+
+      LV2_Atom_Sequence * seq =
+        host.atoms[ZLFO_BREAKPOINTS_OUT];
+
+      /* find the waveforms that ran out of
+       * breakpoints, and their last one */
+      int count[NUM_WAVEFORMS] = { 0 };
+      long last_frame[NUM_WAVEFORMS] = { 0 };
+      LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+        {
+          const LV2_Atom * wave = NULL;
+          lv2_atom_object_get (
+            (const LV2_Atom_Object *) &ev->body,
+            breakpoint_waveform, &wave, NULL);
+          int j = ((const LV2_Atom_Int *) wave)->body;
+          count[j]++;
+          last_frame[j] = ev->time.frames;
+        }
+
+      LV2_Atom_Event * ev =
+        lv2_atom_sequence_begin (&seq->body);
+      for (long k = 0; k < (long) n_samples; k++)
+        {
+          while (
+            !lv2_atom_sequence_is_end (
+              &seq->body, seq->atom.size, ev) &&
+            ev->time.frames <= k)
+            {
+              const LV2_Atom * wave = NULL;
+              const LV2_Atom * value = NULL;
+              const LV2_Atom * slope = NULL;
+              lv2_atom_object_get (
+                (const LV2_Atom_Object *) &ev->body,
+                breakpoint_waveform, &wave,
+                breakpoint_value, &value,
+                breakpoint_slope, &slope, NULL);
+              LastBreakpoint * bp =
+                &last[
+                  ((const LV2_Atom_Int *) wave)->body];
+              bp->valid = 1;
+              bp->frame = offset + k;
+              bp->value =
+                ((const LV2_Atom_Float *) value)->body;
+              bp->slope =
+                ((const LV2_Atom_Float *) slope)->body;
+
+              ev = lv2_atom_sequence_next (ev);
+            }
+
+          for (int j = 0; j < NUM_WAVEFORMS; j++)
+            {
+              /* nothing is sent for the rest of
+               * the cycle */
+              if (count[j] == max_breakpoints &&
+                  k > last_frame[j])
+                continue;
+
+              LastBreakpoint * bp = &last[j];
+              float val =
+                bp->value +
+                bp->slope *
+                  (float) (offset + k - bp->frame);
+              const float * buf =
+                host.cv[get_cv_port (j)];
+              if (!bp->valid ||
+                  fabsf (val - buf[k]) >
+                    tolerance * 1.01f + 1e-6f)
+                {
+                  fprintf (
+                    stderr,
+                    "Overflow: waveform %d at frame "
+                    "%ld: expected %f, got %f\n",
+                    j, offset + k, (double) buf[k],
+                    (double) val);
+                  return -1;
+                }
+            }
+        }
+
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          if (count[j] > max_breakpoints)
+            {
+              fprintf (
+                stderr,
+                "Waveform %d got %d breakpoints, "
+                "more than its share\n",
+                j, count[j]);
+              return -1;
+            }
+          if (count[j] == max_breakpoints)
+            num_overflows++;
+        }
+
+      offset += n_samples;
+    }
+
+  host_cleanup (&host);
+
+  if (num_overflows == 0)
+    {
+      fprintf (stderr, "No overflow\n");
+      return -1;
+    }
+
+  return 0;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  const float freqs[] = {
+    MIN_FREQ, DEF_FREQ, MAX_FREQ };
+  for (size_t i = 0;
+       i < sizeof (freqs) / sizeof (float); i++)
+    {
+      for (int step_mode = 0; step_mode < 2;
+           step_mode++)
+        {
+          long num_breakpoints =
+            check (freqs[i], step_mode);
+          if (num_breakpoints < 0)
+            return 1;
+
+          printf (
+            "freq %f, step mode %d: %ld breakpoints "
+            "for %d samples\n",
+            (double) freqs[i], step_mode,
+            num_breakpoints,
+            NUM_BLOCKS * BLOCK_SIZE * NUM_WAVEFORMS);
+        }
+    }
+
+  if (check_overflow ())
+    return 1;
+
+  return 0;
+}
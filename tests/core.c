@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Tests for the core engine, built without LV2.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zlfo_core.h"
+
+#define SAMPLERATE 48000.0
+#define NUM_FRAMES 100000
+#define CHUNK_SIZE 777
+
+#define FAIL(...) \
+  fprintf (stderr, __VA_ARGS__); \
+  return 1
+
+static ZLfoEngine *
+create_engine (void)
+{
+  ZLfoEngine * engine =
+    zlfo_engine_new (SAMPLERATE);
+  zlfo_engine_set_param (
+    engine, ZLFO_PARAM_FREQ, 3.f);
+  zlfo_engine_set_param (
+    engine, ZLFO_PARAM_SHIFT, 0.3f);
+  zlfo_engine_set_param (
+    engine, ZLFO_PARAM_NUM_NODES, 3.f);
+  zlfo_engine_set_node (
+    engine, 1, 0.4f, 0.2f, 0.f);
+  zlfo_engine_set_node (
+    engine, 2, 0.8f, 0.7f, 0.f);
+  return engine;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  float * expected[ZLFO_NUM_WAVEFORMS];
+  float * actual[ZLFO_NUM_WAVEFORMS];
+  for (int i = 0; i < ZLFO_NUM_WAVEFORMS; i++)
+    {
+      expected[i] =
+        calloc (NUM_FRAMES, sizeof (float));
+      actual[i] =
+        calloc (NUM_FRAMES, sizeof (float));
+    }
+
+  if (zlfo_engine_new (0.0))
+    {
+      FAIL ("Created engine with samplerate 0\n");
+    }
+
+  /* render everything at once */
+  ZLfoEngine * engine = create_engine ();
+  zlfo_engine_render (engine, NUM_FRAMES, expected);
+  if (zlfo_engine_get_position (engine) !=
+        NUM_FRAMES)
+    {
+      FAIL ("Wrong position after rendering\n");
+    }
+  zlfo_engine_free (engine);
+
+  /* render chunks backwards after seeking */
+  engine = create_engine ();
+  int start = (NUM_FRAMES / CHUNK_SIZE) * CHUNK_SIZE;
+  for (; start >= 0; start -= CHUNK_SIZE)
+    {
+      uint32_t n_frames =
+        (uint32_t)
+        (NUM_FRAMES - start < CHUNK_SIZE ?
+           NUM_FRAMES - start : CHUNK_SIZE);
+      float * outs[ZLFO_NUM_WAVEFORMS];
+      for (int i = 0; i < ZLFO_NUM_WAVEFORMS; i++)
+        {
+          outs[i] = &actual[i][start];
+        }
+      zlfo_engine_seek (engine, (uint64_t) start);
+      zlfo_engine_render (engine, n_frames, outs);
+    }
+  for (int i = 0; i < ZLFO_NUM_WAVEFORMS; i++)
+    {
+      if (memcmp (
+            expected[i], actual[i],
+            NUM_FRAMES * sizeof (float)))
+        {
+          FAIL (
+            "Waveform %d differs after seeking\n",
+            i);
+        }
+    }
+
+  /* the output repeats every period (16000
+   * frames at 3 Hz) */
+  for (int i = 0; i < ZLFO_NUM_WAVEFORMS; i++)
+    {
+      if (memcmp (
+            expected[i], &expected[i][16000],
+            (NUM_FRAMES - 16000) * sizeof (float)))
+        {
+          FAIL (
+            "Waveform %d does not repeat\n", i);
+        }
+    }
+
+  /* waveforms without a buffer are skipped and
+   * parameter changes are applied */
+  float * outs[ZLFO_NUM_WAVEFORMS] = {
+    NULL, NULL, NULL, NULL, actual[ZLFO_WAVEFORM_CUSTOM], };
+  memset (
+    actual[ZLFO_WAVEFORM_SINE], 0,
+    NUM_FRAMES * sizeof (float));
+  zlfo_engine_set_param (
+    engine, ZLFO_PARAM_RANGE_MIN, 2.f);
+  zlfo_engine_set_param (
+    engine, ZLFO_PARAM_RANGE_MAX, 3.f);
+  zlfo_engine_seek (engine, 0);
+  zlfo_engine_render (engine, NUM_FRAMES, outs);
+  for (int i = 0; i < NUM_FRAMES; i++)
+    {
+      if (actual[ZLFO_WAVEFORM_SINE][i] > 0.f ||
+          actual[ZLFO_WAVEFORM_SINE][i] < 0.f)
+        {
+          FAIL ("Disabled waveform was rendered\n");
+        }
+      float val = actual[ZLFO_WAVEFORM_CUSTOM][i];
+      if (val < 2.f || val > 3.f)
+        {
+          FAIL (
+            "Value %f out of range\n", (double) val);
+        }
+    }
+  zlfo_engine_free (engine);
+
+  for (int i = 0; i < ZLFO_NUM_WAVEFORMS; i++)
+    {
+      free (expected[i]);
+      free (actual[i]);
+    }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Benchmark that checks that tiny ranges, which
+ * produce subnormal values when scaling the
+ * output, are not slower than the full range.
+ */
+
+#include "config.h"
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 2000
+#define NUM_REPEATS 5
+
+/** Max allowed slowdown of the tiny range
+ * compared to the full range. */
+#define MAX_SLOWDOWN 1.5
+
+/**
+ * Returns the best ns/sample out of a few runs
+ * with the given range.
+ */
+static double
+bench_range (
+  float range_min,
+  float range_max)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    exit (1);
+
+  host.controls[ZLFO_RANGE_MIN] = range_min;
+  host.controls[ZLFO_RANGE_MAX] = range_max;
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SAW_TOGGLE] = 1.f;
+  host.controls[ZLFO_TRIANGLE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SQUARE_TOGGLE] = 1.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  host.controls[ZLFO_FREQ] = MAX_FREQ;
+
+  double best = 0.0;
+  for (int i = 0; i < NUM_REPEATS; i++)
+    {
+      double start = host_get_time_ns ();
+      for (int j = 0; j < NUM_BLOCKS; j++)
+        {
+          host_run (&host, BLOCK_SIZE);
+        }
+      double ns_per_sample =
+        (host_get_time_ns () - start) /
+        (double) (NUM_BLOCKS * BLOCK_SIZE);
+      if (i == 0 || ns_per_sample < best)
+        best = ns_per_sample;
+    }
+
+  host_cleanup (&host);
+
+  return best;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  double full = bench_range (-1.f, 1.f);
+
+  /* most of the scaled values and intermediate
+   * products become subnormal */
+  double tiny = bench_range (0.f, 2e-38f);
+
+  double slowdown = tiny / full;
+  printf (
+    "full range: %.3f ns/sample\n"
+    "tiny range: %.3f ns/sample\n"
+    "slowdown: %.3f\n",
+    full, tiny, slowdown);
+
+  if (slowdown > MAX_SLOWDOWN)
+    {
+      fprintf (
+        stderr,
+        "Tiny range is %.2fx slower than the full "
+        "range, subnormals are not flushed\n",
+        slowdown);
+      return 1;
+    }
+
+  return 0;
+}
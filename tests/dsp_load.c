@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that the DSP load statistics are sent to
+ * the UI periodically while it is active, and that
+ * histograms that are not int vectors are
+ * ignored.
+ *
+ * Skipped where the DSP load is not measured.
+ */
+
+#include "config.h"
+
+#include "lv2_host.h"
+#include "zlfo_math.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 1000
+
+/**
+ * Runs a block and returns the number of dsp_load
+ * objects in the notify output.
+ */
+static int
+run_and_count_dsp_loads (
+  Host *     host,
+  ZLfoUris * uris,
+  DspLoad *  load)
+{
+  host_run (host, BLOCK_SIZE);
+
+  LV2_Atom_Sequence * seq =
+    host->atoms[ZLFO_NOTIFY];
+  if (seq->atom.type !=
+        host_map_uri (
+          &host->urid_map, LV2_ATOM__Sequence))
+    {
+      fprintf (stderr, "Notify is not a sequence\n");
+      exit (1);
+    }
+
+  int count = 0;
+  LV2_ATOM_SEQUENCE_FOREACH (seq, ev)
+    {
+      const LV2_Atom_Object * obj =
+        (const LV2_Atom_Object *) &ev->body;
+      if (obj->body.otype == uris->dsp_load)
+        {
+          update_dsp_load_from_atom_obj (
+            load, uris, obj);
+          count++;
+        }
+    }
+  return count;
+}
+
+/**
+ * Parses a dsp_load object whose histogram is an
+ * atom of the given type and size, with the
+ * contents of an int vector cut to that size.
+ *
+ * @return 0 if the histogram was ignored.
+ */
+static int
+check_invalid_histogram (
+  Host *     host,
+  ZLfoUris * uris,
+  LV2_URID   type,
+  uint32_t   size)
+{
+  struct
+  {
+    LV2_Atom_Vector_Body body;
+    int32_t              histogram[
+      DSP_LOAD_HISTOGRAM_SIZE];
+  } vec;
+  vec.body.child_size = sizeof (int32_t);
+  vec.body.child_type = uris->atom_Int;
+  for (int i = 0; i < DSP_LOAD_HISTOGRAM_SIZE; i++)
+    {
+      vec.histogram[i] = i + 1;
+    }
+
+  uint8_t buf[256];
+  LV2_Atom_Forge forge;
+  lv2_atom_forge_init (&forge, &host->map);
+  lv2_atom_forge_set_buffer (
+    &forge, buf, sizeof (buf));
+  LV2_Atom_Forge_Frame frame;
+  lv2_atom_forge_object (
+    &forge, &frame, 0, uris->dsp_load);
+  lv2_atom_forge_key (
+    &forge, uris->dsp_load_histogram);
+  lv2_atom_forge_atom (&forge, size, type);
+  lv2_atom_forge_write (
+    &forge, &vec, MIN (size, sizeof (vec)));
+  lv2_atom_forge_pop (&forge, &frame);
+
+  DspLoad load;
+  memset (&load, 0, sizeof (load));
+  update_dsp_load_from_atom_obj (
+    &load, uris, (const LV2_Atom_Object *) buf);
+  for (int i = 0; i < DSP_LOAD_HISTOGRAM_SIZE; i++)
+    {
+      if (load.histogram[i] != 0)
+        {
+          fprintf (
+            stderr,
+            "Invalid histogram was parsed\n");
+          return 1;
+        }
+    }
+
+  return 0;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+#ifndef HAVE_CYCLE_COUNTER
+  /* skip */
+  return 77;
+#endif
+
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    return 1;
+
+  ZLfoUris uris;
+  map_uris (&host.map, &uris);
+
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+
+  /* nothing is sent without a UI */
+  DspLoad load;
+  memset (&load, 0, sizeof (load));
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      if (run_and_count_dsp_loads (
+            &host, &uris, &load))
+        {
+          fprintf (stderr, "Sent without a UI\n");
+          return 1;
+        }
+    }
+
+  host_send_message (&host, 0, LFO_URI "#ui_on");
+  int num_updates = 0;
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      num_updates +=
+        run_and_count_dsp_loads (
+          &host, &uris, &load);
+    }
+
+  /* about 5 seconds of audio */
+  int expected =
+    (int)
+    ((NUM_BLOCKS * BLOCK_SIZE / SAMPLERATE) *
+     DSP_LOAD_UPDATES_PER_SEC);
+  if (num_updates < expected - 1 ||
+      num_updates > expected + 1)
+    {
+      fprintf (
+        stderr, "Expected %d updates, got %d\n",
+        expected, num_updates);
+      return 1;
+    }
+
+  int histogram_blocks = 0;
+  for (int i = 0; i < DSP_LOAD_HISTOGRAM_SIZE; i++)
+    {
+      histogram_blocks += load.histogram[i];
+    }
+  printf (
+    "DSP load: min %f avg %f max %f over %d "
+    "blocks\n",
+    (double) load.min, (double) load.avg,
+    (double) load.max, load.num_blocks);
+  if (load.num_blocks <= 0 ||
+      histogram_blocks != load.num_blocks ||
+      load.min > load.avg || load.avg > load.max)
+    {
+      fprintf (stderr, "Inconsistent statistics\n");
+      return 1;
+    }
+
+  /* not a vector, and a vector too short for its
+   * body */
+  if (check_invalid_histogram (
+        &host, &uris,
+        host_map_uri (
+          &host.urid_map, LV2_ATOM__Chunk),
+        sizeof (LV2_Atom_Vector_Body) +
+          DSP_LOAD_HISTOGRAM_SIZE *
+            sizeof (int32_t)) ||
+      check_invalid_histogram (
+        &host, &uris, uris.atom_Vector, 4))
+    return 1;
+
+  host_cleanup (&host);
+
+  return 0;
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Compares the output of run() for a set of
+ * canonical scenarios against stored reference
+ * outputs.
+ *
+ * Usage:
+ *   golden <reference file>
+ *   golden --generate <reference file>
+ *
+ * The reference file has one line per scenario
+ * and waveform, with every STRIDE-th sample of
+ * the output.
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 512
+#define NUM_BLOCKS 4
+#define NUM_FRAMES (BLOCK_SIZE * NUM_BLOCKS)
+
+/** Only every STRIDE-th sample is stored. */
+#define STRIDE 32
+#define NUM_VALUES (NUM_FRAMES / STRIDE)
+
+#define MAX_CONTROLS 8
+
+typedef struct Control
+{
+  /** Port index, 0 for unused entries. */
+  int   port;
+  float val;
+} Control;
+
+typedef struct Scenario
+{
+  const char * name;
+
+  /** Controls to set on top of the defaults. */
+  Control      controls[MAX_CONTROLS];
+
+  /** Send a time position (120 BPM, 4/4) before
+   * the first block. */
+  int          sync;
+
+  /** Block to enable the trigger control for, or
+   * 0 for none. */
+  int          trigger_block;
+
+  /** Frame to send a CV trigger at, or 0 for
+   * none. */
+  int          cv_trigger_frame;
+
+  /** Use gated mode with the CV gate open for the
+   * first half of each block. */
+  int          cv_gate;
+} Scenario;
+
+/**
+ * Error tolerance of each kernel.
+ */
+typedef struct Tolerance
+{
+  /** Max absolute error. */
+  float max_error;
+
+  /** Number of values allowed to exceed the max
+   * error, for kernels with discontinuities where
+   * an edge may move by a sample. */
+  int   max_outliers;
+} Tolerance;
+
+/** Tolerances, indexed by Waveform. */
+static const Tolerance tolerances[NUM_WAVEFORMS] = {
+  [WAVEFORM_SINE] = { 1e-4f, 0 },
+  [WAVEFORM_TRIANGLE] = { 1e-5f, 0 },
+  [WAVEFORM_SAW] = { 1e-5f, 2 },
+  [WAVEFORM_SQUARE] = { 1e-5f, 2 },
+  [WAVEFORM_CUSTOM] = { 1e-5f, 2 },
+};
+
+static const int outputs[NUM_WAVEFORMS] = {
+  ZLFO_SINE_OUT, ZLFO_TRIANGLE_OUT,
+  ZLFO_SAW_OUT, ZLFO_SQUARE_OUT,
+  ZLFO_CUSTOM_OUT, };
+
+static const char * wave_strs[NUM_WAVEFORMS] = {
+  "sine", "triangle", "saw", "square", "custom", };
+
+#define FREQ(x) { ZLFO_FREQ, x }
+#define SYNC_RATE(x, type) \
+  { ZLFO_FREE_RUNNING, 0.f }, \
+  { ZLFO_SYNC_RATE, SYNC_##x }, \
+  { ZLFO_SYNC_RATE_TYPE, SYNC_TYPE_##type }
+#define STEP(x) \
+  { ZLFO_STEP_MODE, 1.f }, \
+  { ZLFO_GRID_STEP, GRID_STEP_##x }
+
+static const Scenario scenarios[] = {
+  { "default", { FREQ (40.f) }, },
+  { "slow", { FREQ (MIN_FREQ) }, },
+  { "fast", { FREQ (MAX_FREQ) }, },
+  { "range",
+    { FREQ (40.f), { ZLFO_RANGE_MIN, 0.2f },
+      { ZLFO_RANGE_MAX, -3.f } }, },
+  { "hinvert",
+    { FREQ (40.f), { ZLFO_HINVERT, 1.f } }, },
+  { "vinvert",
+    { FREQ (40.f), { ZLFO_VINVERT, 1.f } }, },
+  { "shift_0",
+    { FREQ (40.f), { ZLFO_SHIFT, 0.f } }, },
+  { "shift_0.3",
+    { FREQ (40.f), { ZLFO_SHIFT, 0.3f } }, },
+  { "shift_0.8_hinvert",
+    { FREQ (40.f), { ZLFO_SHIFT, 0.8f },
+      { ZLFO_HINVERT, 1.f } }, },
+  { "step_full", { FREQ (40.f), STEP (FULL) }, },
+  { "step_half", { FREQ (40.f), STEP (HALF) }, },
+  { "step_fourth", { FREQ (40.f), STEP (FOURTH) }, },
+  { "step_eighth", { FREQ (40.f), STEP (EIGHTH) }, },
+  { "step_sixteenth",
+    { FREQ (40.f), STEP (SIXTEENTH) }, },
+  { "step_thirty_second",
+    { FREQ (40.f), STEP (THIRTY_SECOND) }, },
+  { "sync_1_16", { SYNC_RATE (1_16, NORMAL) }, 1, },
+  { "sync_1_16_dotted",
+    { SYNC_RATE (1_16, DOTTED) }, 1, },
+  { "sync_1_16_triplet",
+    { SYNC_RATE (1_16, TRIPLET) }, 1, },
+  { "sync_1_32_triplet",
+    { SYNC_RATE (1_32, TRIPLET) }, 1, },
+  { "sync_1_4", { SYNC_RATE (1_4, NORMAL) }, 1, },
+  { "nodes",
+    { FREQ (40.f), { ZLFO_NUM_NODES, 4.f },
+      { ZLFO_NODE_2_POS, 0.25f },
+      { ZLFO_NODE_2_VAL, 0.1f },
+      { ZLFO_NODE_3_POS, 0.6f },
+      { ZLFO_NODE_3_VAL, 0.9f },
+      { ZLFO_NODE_4_POS, 0.9f } }, },
+  { "node_curves",
+    { FREQ (40.f), { ZLFO_NUM_NODES, 3.f },
+      { ZLFO_NODE_1_CURVE, 0.7f },
+      { ZLFO_NODE_2_POS, 0.4f },
+      { ZLFO_NODE_2_CURVE, 0.2f },
+      { ZLFO_NODE_3_POS, 1.f },
+      { ZLFO_NODE_3_VAL, 0.5f } }, },
+  { "trigger", { FREQ (40.f) }, 0, 2, },
+  { "cv_trigger", { FREQ (40.f) }, 0, 0, 700, },
+  { "cv_gate", { FREQ (40.f) }, 0, 0, 0, 1, },
+  { "gate",
+    { FREQ (40.f), { ZLFO_GATED_MODE, 1.f },
+      { ZLFO_GATE, 1.f } }, },
+};
+
+#define NUM_SCENARIOS \
+  (int) (sizeof (scenarios) / sizeof (Scenario))
+
+/**
+ * Renders the scenario and stores every STRIDE-th
+ * sample of each waveform in @p values.
+ */
+static void
+render (
+  const Scenario * scenario,
+  float            values[NUM_WAVEFORMS][NUM_VALUES])
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    exit (1);
+
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      host.controls[
+        ZLFO_SINE_TOGGLE + i] = 1.f;
+    }
+  for (int i = 0; i < MAX_CONTROLS; i++)
+    {
+      const Control * control =
+        &scenario->controls[i];
+      if (control->port)
+        host.controls[control->port] = control->val;
+    }
+  if (scenario->cv_gate)
+    {
+      host.controls[ZLFO_GATED_MODE] = 1.f;
+      for (int i = 0; i < BLOCK_SIZE / 2; i++)
+        {
+          host.cv[ZLFO_CV_GATE][i] = 1.f;
+        }
+    }
+  if (scenario->sync)
+    {
+      host_send_position (
+        &host, 0, 0, 120.f, 4, 1.f);
+    }
+
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      host.controls[ZLFO_TRIGGER] =
+        i > 0 && i == scenario->trigger_block ?
+          1.f : 0.f;
+      for (int j = 0; j < BLOCK_SIZE; j++)
+        {
+          host.cv[ZLFO_CV_TRIGGER][j] =
+            scenario->cv_trigger_frame > 0 &&
+            i * BLOCK_SIZE + j ==
+              scenario->cv_trigger_frame ?
+              1.f : 0.f;
+        }
+
+      host_run (&host, BLOCK_SIZE);
+
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          for (int k = 0; k < BLOCK_SIZE;
+               k += STRIDE)
+            {
+              values[j][(i * BLOCK_SIZE + k) /
+                        STRIDE] =
+                host.cv[outputs[j]][k];
+            }
+        }
+    }
+
+  host_cleanup (&host);
+}
+
+static int
+generate (
+  const char * path)
+{
+  FILE * f = fopen (path, "w");
+  if (!f)
+    {
+      fprintf (stderr, "Failed to open %s\n", path);
+      return 1;
+    }
+
+  float values[NUM_WAVEFORMS][NUM_VALUES];
+  for (int i = 0; i < NUM_SCENARIOS; i++)
+    {
+      render (&scenarios[i], values);
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          fprintf (
+            f, "%s %s", scenarios[i].name,
+            wave_strs[j]);
+          for (int k = 0; k < NUM_VALUES; k++)
+            {
+              fprintf (
+                f, " %.7g", (double) values[j][k]);
+            }
+          fprintf (f, "\n");
+        }
+    }
+
+  fclose (f);
+
+  return 0;
+}
+
+/**
+ * Reads the reference values of the scenario and
+ * waveform at the current position of @p f.
+ *
+ * @return Non-zero if failed.
+ */
+static int
+read_reference (
+  FILE *           f,
+  const Scenario * scenario,
+  int              wave,
+  float            values[NUM_VALUES])
+{
+  char name[100];
+  char wave_str[100];
+  if (fscanf (f, "%99s %99s", name, wave_str) != 2 ||
+      strcmp (name, scenario->name) ||
+      strcmp (wave_str, wave_strs[wave]))
+    {
+      fprintf (
+        stderr,
+        "Reference for %s %s not found, "
+        "regenerate it with --generate\n",
+        scenario->name, wave_strs[wave]);
+      return 1;
+    }
+  for (int i = 0; i < NUM_VALUES; i++)
+    {
+      if (fscanf (f, "%f", &values[i]) != 1)
+        {
+          fprintf (
+            stderr,
+            "Reference for %s %s is truncated\n",
+            scenario->name, wave_strs[wave]);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+static int
+compare (
+  const char * path)
+{
+  FILE * f = fopen (path, "r");
+  if (!f)
+    {
+      fprintf (stderr, "Failed to open %s\n", path);
+      return 1;
+    }
+
+  int ret = 0;
+  float values[NUM_WAVEFORMS][NUM_VALUES];
+  float ref[NUM_VALUES];
+  for (int i = 0; i < NUM_SCENARIOS; i++)
+    {
+      const Scenario * scenario = &scenarios[i];
+      render (scenario, values);
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          if (read_reference (f, scenario, j, ref))
+            {
+              fclose (f);
+              return 1;
+            }
+
+          const Tolerance * tol = &tolerances[j];
+          float max_error = 0.f;
+          int outliers = 0;
+          for (int k = 0; k < NUM_VALUES; k++)
+            {
+              float error =
+                fabsf (values[j][k] - ref[k]);
+              max_error = MAX (max_error, error);
+              if (error > tol->max_error)
+                outliers++;
+            }
+          if (outliers > tol->max_outliers)
+            {
+              fprintf (
+                stderr,
+                "%s %s: %d values differ (max "
+                "error %g)\n",
+                scenario->name, wave_strs[j],
+                outliers, (double) max_error);
+              ret = 1;
+            }
+        }
+    }
+
+  fclose (f);
+
+  return ret;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  if (argc == 3 && !strcmp (argv[1], "--generate"))
+    {
+      return generate (argv[2]);
+    }
+  else if (argc == 2)
+    {
+      return compare (argv[1]);
+    }
+
+  fprintf (
+    stderr,
+    "Usage: %s [--generate] <reference file>\n",
+    argv[0]);
+  return 1;
+}
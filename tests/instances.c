@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Benchmark of many plugin instances running
+ * round-robin like in a host, to see how the
+ * memory footprint of each instance affects
+ * throughput once the working set no longer fits
+ * in the caches.
+ *
+ * Results are printed as CSV, one line per
+ * instance count.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+
+/** Samples to process in total for each instance
+ * count, split between the instances. */
+#define TOTAL_SAMPLES (1 << 23)
+
+static const int instance_counts[] = {
+  1, 10, 100, 1000, };
+
+/**
+ * Returns the resident set size of the process in
+ * bytes, or 0 if unknown.
+ */
+static size_t
+get_rss (void)
+{
+  FILE * f = fopen ("/proc/self/statm", "r");
+  if (!f)
+    return 0;
+
+  unsigned long size, resident;
+  int ret =
+    fscanf (f, "%lu %lu", &size, &resident);
+  fclose (f);
+  if (ret != 2)
+    return 0;
+
+  return
+    (size_t) resident *
+    (size_t) sysconf (_SC_PAGESIZE);
+}
+
+static double
+get_cpu_time_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return
+    (double) ts.tv_sec * 1000000000.0 +
+    (double) ts.tv_nsec;
+}
+
+/**
+ * Returns the size of the buffers the host
+ * connects to each instance.
+ */
+static size_t
+get_port_buffers_size (void)
+{
+  size_t size = 0;
+  for (uint32_t i = 0; i < NUM_ZLFO_PORTS; i++)
+    {
+      if (host_port_is_cv (i))
+        size += BLOCK_SIZE * sizeof (float);
+      else if (host_port_is_atom (i))
+        size += HOST_ATOM_CAPACITY;
+      else
+        size += sizeof (float);
+    }
+  return size;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  long l1_size = 0, l2_size = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+  l1_size = sysconf (_SC_LEVEL1_DCACHE_SIZE);
+  l2_size = sysconf (_SC_LEVEL2_CACHE_SIZE);
+#endif
+  printf (
+    "# L1d %ld bytes, L2 %ld bytes\n",
+    l1_size, l2_size);
+  printf (
+    "instances,instance_heap_bytes,"
+    "rss_bytes_per_instance,port_buffer_bytes,"
+    "working_set_bytes,cpu_ms,"
+    "ns_per_instance_sample,slowdown\n");
+
+  double base_ns = 0.0;
+  for (size_t i = 0;
+       i < sizeof (instance_counts) / sizeof (int);
+       i++)
+    {
+      int num_instances = instance_counts[i];
+      Host * hosts =
+        calloc (
+          (size_t) num_instances, sizeof (Host));
+
+      size_t rss = get_rss ();
+      size_t heap_size = 0;
+      for (int j = 0; j < num_instances; j++)
+        {
+          Host * host = &hosts[j];
+          if (host_init (host, SAMPLERATE, BLOCK_SIZE))
+            return 1;
+
+          host->controls[ZLFO_SINE_TOGGLE] = 1.f;
+          host->controls[ZLFO_SAW_TOGGLE] = 1.f;
+          host->controls[ZLFO_TRIANGLE_TOGGLE] = 1.f;
+          host->controls[ZLFO_SQUARE_TOGGLE] = 1.f;
+          host->controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+
+          /* spread the frequencies so the instances
+           * don't all do the same work */
+          host->controls[ZLFO_FREQ] =
+            DEF_FREQ + (float) (j % 50);
+
+          heap_size += host->instance_heap_size;
+        }
+      size_t rss_per_instance =
+        (get_rss () - rss) / (size_t) num_instances;
+      size_t instance_heap_size =
+        heap_size / (size_t) num_instances;
+      size_t port_buffers_size =
+        get_port_buffers_size ();
+
+      /* warm up */
+      for (int j = 0; j < num_instances; j++)
+        {
+          host_run (&hosts[j], BLOCK_SIZE);
+        }
+
+      int num_cycles =
+        MAX (
+          TOTAL_SAMPLES /
+            (BLOCK_SIZE * num_instances), 1);
+      double start = get_cpu_time_ns ();
+      for (int j = 0; j < num_cycles; j++)
+        {
+          for (int k = 0; k < num_instances; k++)
+            {
+              host_run (&hosts[k], BLOCK_SIZE);
+            }
+        }
+      double cpu_ns = get_cpu_time_ns () - start;
+      double ns_per_sample =
+        cpu_ns /
+        ((double) num_cycles * BLOCK_SIZE *
+         num_instances);
+      if (i == 0)
+        base_ns = ns_per_sample;
+
+      printf (
+        "%d,%zu,%zu,%zu,%zu,%.3f,%.3f,%.3f\n",
+        num_instances, instance_heap_size,
+        rss_per_instance, port_buffers_size,
+        (instance_heap_size + port_buffers_size) *
+          (size_t) num_instances,
+        cpu_ns / 1000000.0, ns_per_sample,
+        ns_per_sample / base_ns);
+      fflush (stdout);
+
+      for (int j = 0; j < num_instances; j++)
+        {
+          host_cleanup (&hosts[j]);
+        }
+      free (hosts);
+    }
+
+  return 0;
+}
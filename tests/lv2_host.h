@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Minimal in-process LV2 host used by the tests
+ * and benchmarks.
+ *
+ * The plugin is loaded through lv2_descriptor()
+ * and every port is connected to a buffer owned
+ * by the host, like a real host would do.
+ */
+
+#ifndef __ZLFO_TESTS_LV2_HOST_H__
+#define __ZLFO_TESTS_LV2_HOST_H__
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined (__GLIBC__) && \
+  (__GLIBC__ > 2 || \
+   (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+#include "zlfo_common.h"
+
+#include "lv2/atom/forge.h"
+#include "lv2/atom/util.h"
+
+/** Max number of URIs the host can map. */
+#define HOST_MAX_URIDS 256
+
+/** Capacity of each atom port buffer, at least
+ * the rsz:minimumSize of every atom port. */
+#define HOST_ATOM_CAPACITY 32768
+
+typedef struct HostUridMap
+{
+  char *   uris[HOST_MAX_URIDS];
+  uint32_t num_uris;
+} HostUridMap;
+
+typedef struct Host
+{
+  const LV2_Descriptor * descriptor;
+  LV2_Handle             handle;
+
+  HostUridMap            urid_map;
+  LV2_URID_Map           map;
+  LV2_Feature            map_feature;
+  const LV2_Feature *    features[2];
+
+  LV2_URID               atom_Chunk;
+
+  /** Forge for events sent to the plugin. */
+  LV2_Atom_Forge         forge;
+
+  /** Max block size. */
+  uint32_t               max_block;
+
+  /** Heap memory allocated by instantiate(), or
+   * 0 if unknown. */
+  size_t                 instance_heap_size;
+
+  double                 samplerate;
+
+  /** Control port values, indexed by port. */
+  float                  controls[NUM_ZLFO_PORTS];
+
+  /** Audio-rate buffers (CV in/out), indexed by
+   * port. NULL for other port types. */
+  float *                cv[NUM_ZLFO_PORTS];
+
+  /** Atom port buffers, indexed by port. */
+  LV2_Atom_Sequence *    atoms[NUM_ZLFO_PORTS];
+} Host;
+
+static LV2_URID
+host_map_uri (
+  LV2_URID_Map_Handle handle,
+  const char *        uri)
+{
+  HostUridMap * map = (HostUridMap *) handle;
+  for (uint32_t i = 0; i < map->num_uris; i++)
+    {
+      if (!strcmp (map->uris[i], uri))
+        return i + 1;
+    }
+  if (map->num_uris == HOST_MAX_URIDS)
+    {
+      fprintf (stderr, "URID map full\n");
+      abort ();
+    }
+  map->uris[map->num_uris] = strdup (uri);
+  return ++map->num_uris;
+}
+
+static inline int
+host_port_is_cv (
+  uint32_t port)
+{
+  switch (port)
+    {
+    case ZLFO_CV_GATE:
+    case ZLFO_CV_TRIGGER:
+    case ZLFO_SINE_OUT:
+    case ZLFO_TRIANGLE_OUT:
+    case ZLFO_SAW_OUT:
+    case ZLFO_SQUARE_OUT:
+    case ZLFO_CUSTOM_OUT:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+static inline int
+host_port_is_atom (
+  uint32_t port)
+{
+  switch (port)
+    {
+    case ZLFO_CONTROL:
+    case ZLFO_NOTIFY:
+    case ZLFO_MIDI_OUT:
+    case ZLFO_BREAKPOINTS_OUT:
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+/**
+ * Sets the control ports to the defaults in the
+ * plugin TTL.
+ */
+static inline void
+host_set_default_controls (
+  Host * self)
+{
+  memset (
+    self->controls, 0, sizeof (self->controls));
+  self->controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  self->controls[ZLFO_SYNC_RATE] = SYNC_1_4;
+  self->controls[ZLFO_SYNC_RATE_TYPE] =
+    SYNC_TYPE_NORMAL;
+  self->controls[ZLFO_GRID_STEP] = GRID_STEP_EIGHTH;
+  self->controls[ZLFO_FREQ] = DEF_FREQ;
+  self->controls[ZLFO_SHIFT] = 0.5f;
+  self->controls[ZLFO_RANGE_MIN] = -1.f;
+  self->controls[ZLFO_RANGE_MAX] = 1.f;
+  self->controls[ZLFO_FREE_RUNNING] = 1.f;
+  self->controls[ZLFO_NUM_NODES] = 2.f;
+  self->controls[ZLFO_NODE_1_VAL] = 1.f;
+  self->controls[ZLFO_NODE_2_POS] = 1.f;
+  self->controls[ZLFO_MIDI_SOURCE] = WAVEFORM_CUSTOM;
+  self->controls[ZLFO_MIDI_CHANNEL] = 1.f;
+  self->controls[ZLFO_MIDI_CC] =
+    LV2_MIDI_CTL_MSB_MODWHEEL;
+  self->controls[ZLFO_MIDI_MAX_RATE] = 100.f;
+  self->controls[ZLFO_BREAKPOINTS_TOLERANCE] = 0.001f;
+  self->controls[ZLFO_UI_UPDATE_RATE] =
+    DEF_UI_UPDATE_RATE;
+}
+
+/**
+ * Instantiates the plugin, connects all of its
+ * ports and activates it.
+ *
+ * @return Non-zero if failed.
+ */
+static inline int
+host_init (
+  Host *   self,
+  double   samplerate,
+  uint32_t max_block)
+{
+  memset (self, 0, sizeof (Host));
+  self->samplerate = samplerate;
+  self->max_block = max_block;
+
+  self->map.handle = &self->urid_map;
+  self->map.map = host_map_uri;
+  self->map_feature.URI = LV2_URID__map;
+  self->map_feature.data = &self->map;
+  self->features[0] = &self->map_feature;
+  self->features[1] = NULL;
+  self->atom_Chunk =
+    host_map_uri (&self->urid_map, LV2_ATOM__Chunk);
+  lv2_atom_forge_init (&self->forge, &self->map);
+
+  /* map the plugin URIs in advance so that the
+   * map does not count towards the instance
+   * memory */
+  ZLfoUris uris;
+  map_uris (&self->map, &uris);
+
+  self->descriptor = lv2_descriptor (0);
+  if (!self->descriptor)
+    {
+      fprintf (stderr, "No plugin descriptor\n");
+      return -1;
+    }
+#ifdef HAVE_MALLINFO2
+  size_t heap_size = mallinfo2 ().uordblks;
+#endif
+  self->handle =
+    self->descriptor->instantiate (
+      self->descriptor, samplerate, "",
+      self->features);
+#ifdef HAVE_MALLINFO2
+  self->instance_heap_size =
+    mallinfo2 ().uordblks - heap_size;
+#endif
+  if (!self->handle)
+    {
+      fprintf (stderr, "Failed to instantiate\n");
+      return -1;
+    }
+
+  host_set_default_controls (self);
+  for (uint32_t i = 0; i < NUM_ZLFO_PORTS; i++)
+    {
+      void * data = NULL;
+      if (host_port_is_cv (i))
+        {
+          self->cv[i] =
+            calloc (max_block, sizeof (float));
+          data = self->cv[i];
+        }
+      else if (host_port_is_atom (i))
+        {
+          self->atoms[i] =
+            calloc (1, HOST_ATOM_CAPACITY);
+          data = self->atoms[i];
+        }
+      else
+        {
+          data = &self->controls[i];
+        }
+      self->descriptor->connect_port (
+        self->handle, i, data);
+    }
+
+  /* start with an empty event sequence */
+  self->atoms[ZLFO_CONTROL]->atom.type =
+    host_map_uri (
+      &self->urid_map, LV2_ATOM__Sequence);
+  lv2_atom_sequence_clear (
+    self->atoms[ZLFO_CONTROL]);
+
+  self->descriptor->activate (self->handle);
+
+  return 0;
+}
+
+/**
+ * Runs the plugin for @p n_samples, resetting the
+ * atom buffers first like a host does before each
+ * cycle.
+ */
+static inline void
+host_run (
+  Host *   self,
+  uint32_t n_samples)
+{
+  /* give the plugin the full capacity of the
+   * output buffers */
+  for (uint32_t i = 0; i < NUM_ZLFO_PORTS; i++)
+    {
+      if (i == ZLFO_CONTROL || !self->atoms[i])
+        continue;
+
+      self->atoms[i]->atom.type = self->atom_Chunk;
+      self->atoms[i]->atom.size =
+        HOST_ATOM_CAPACITY - sizeof (LV2_Atom);
+    }
+
+  self->descriptor->run (self->handle, n_samples);
+
+  /* events are consumed */
+  lv2_atom_sequence_clear (
+    self->atoms[ZLFO_CONTROL]);
+}
+
+/**
+ * Buffer for forging an event to send to the
+ * plugin.
+ */
+typedef union HostEvent
+{
+  LV2_Atom_Event ev;
+  uint8_t        buf[256];
+} HostEvent;
+
+/**
+ * Sets up the forge to write the body of @p event.
+ */
+static inline LV2_Atom_Forge *
+host_begin_event (
+  Host *      self,
+  HostEvent * event,
+  uint32_t    time)
+{
+  lv2_atom_forge_set_buffer (
+    &self->forge, (uint8_t *) &event->ev.body,
+    sizeof (HostEvent) - sizeof (LV2_Atom_Event));
+  event->ev.time.frames = time;
+  return &self->forge;
+}
+
+/**
+ * Appends the forged @p event to the control
+ * sequence for the next run.
+ *
+ * @return Non-zero if there was no space.
+ */
+static inline int
+host_end_event (
+  Host *      self,
+  HostEvent * event)
+{
+  if (!lv2_atom_sequence_append_event (
+         self->atoms[ZLFO_CONTROL],
+         HOST_ATOM_CAPACITY - sizeof (LV2_Atom),
+         &event->ev))
+    {
+      return -1;
+    }
+
+  return 0;
+}
+
+/**
+ * Queues a time:Position event for the next run,
+ * like a host does when the transport changes.
+ *
+ * @param time Frame in the next cycle.
+ * @param frame Global transport frame.
+ *
+ * @return Non-zero if there was no space.
+ */
+static inline int
+host_send_position (
+  Host *   self,
+  uint32_t time,
+  long     frame,
+  float    bpm,
+  int      beat_unit,
+  float    speed)
+{
+  HostEvent event;
+  LV2_Atom_Forge * forge =
+    host_begin_event (self, &event, time);
+
+#define MAP_URI(x) \
+  host_map_uri (&self->urid_map, x)
+
+  LV2_Atom_Forge_Frame obj_frame;
+  lv2_atom_forge_object (
+    forge, &obj_frame, 0,
+    MAP_URI (LV2_TIME__Position));
+  lv2_atom_forge_key (forge, MAP_URI (LV2_TIME__frame));
+  lv2_atom_forge_long (forge, frame);
+  lv2_atom_forge_key (
+    forge, MAP_URI (LV2_TIME__beatsPerMinute));
+  lv2_atom_forge_float (forge, bpm);
+  lv2_atom_forge_key (
+    forge, MAP_URI (LV2_TIME__beatUnit));
+  lv2_atom_forge_int (forge, beat_unit);
+  lv2_atom_forge_key (forge, MAP_URI (LV2_TIME__speed));
+  lv2_atom_forge_float (forge, speed);
+  lv2_atom_forge_pop (forge, &obj_frame);
+
+#undef MAP_URI
+
+  return host_end_event (self, &event);
+}
+
+/**
+ * Queues an object without properties, like the
+ * ui_on and ui_off messages of the UI.
+ *
+ * @return Non-zero if there was no space.
+ */
+static inline int
+host_send_message (
+  Host *       self,
+  uint32_t     time,
+  const char * type_uri)
+{
+  HostEvent event;
+  LV2_Atom_Forge * forge =
+    host_begin_event (self, &event, time);
+
+  LV2_Atom_Forge_Frame obj_frame;
+  lv2_atom_forge_object (
+    forge, &obj_frame, 0,
+    host_map_uri (&self->urid_map, type_uri));
+  lv2_atom_forge_pop (forge, &obj_frame);
+
+  return host_end_event (self, &event);
+}
+
+static inline void
+host_cleanup (
+  Host * self)
+{
+  self->descriptor->deactivate (self->handle);
+  self->descriptor->cleanup (self->handle);
+  for (uint32_t i = 0; i < NUM_ZLFO_PORTS; i++)
+    {
+      free (self->cv[i]);
+      free (self->atoms[i]);
+    }
+  for (uint32_t i = 0;
+       i < self->urid_map.num_uris; i++)
+    {
+      free (self->urid_map.uris[i]);
+    }
+}
+
+/**
+ * Returns the monotonic time in nanoseconds.
+ */
+static inline double
+host_get_time_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return
+    (double) ts.tv_sec * 1000000000.0 +
+    (double) ts.tv_nsec;
+}
+
+#endif
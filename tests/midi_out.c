@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that the MIDI output follows the source
+ * waveform over the whole MIDI range for
+ * non-default output ranges, and that out of
+ * range mode and channel values are clamped.
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 200
+
+typedef struct MidiOutCase
+{
+  float mode;
+  float channel;
+  float range_min;
+  float range_max;
+
+  /** Expected mode after clamping. */
+  MidiOutMode expected_mode;
+
+  /** Expected channel (0 to 15) after
+   * clamping. */
+  int         expected_channel;
+} MidiOutCase;
+
+static const MidiOutCase cases[] = {
+  { MIDI_OUT_CC, 3.f, 0.2f, 0.4f,
+    MIDI_OUT_CC, 2 },
+  { MIDI_OUT_CC_14BIT, 1.f, -0.1f, 0.1f,
+    MIDI_OUT_CC_14BIT, 0 },
+  { MIDI_OUT_PITCH_BEND, 16.f, -3.f, -2.f,
+    MIDI_OUT_PITCH_BEND, 15 },
+  /* reversed range */
+  { MIDI_OUT_CC, 1.f, 1.f, 0.5f,
+    MIDI_OUT_CC, 0 },
+  /* out of range */
+  { -2.f, 1.f, -1.f, 1.f,
+    MIDI_OUT_OFF, 0 },
+  { 9.7f, 100.f, -1.f, 1.f,
+    MIDI_OUT_PITCH_BEND, 15 },
+  { MIDI_OUT_CC, -5.f, -1.f, 1.f,
+    MIDI_OUT_CC, 0 },
+};
+
+static int
+check_case (
+  const MidiOutCase * c)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    return 1;
+
+  LV2_URID midi_event =
+    host_map_uri (
+      &host.urid_map, LV2_MIDI__MidiEvent);
+
+  host.controls[ZLFO_FREQ] = 5.f;
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_MIDI_SOURCE] = WAVEFORM_SINE;
+  host.controls[ZLFO_MIDI_MODE] = c->mode;
+  host.controls[ZLFO_MIDI_CHANNEL] = c->channel;
+  host.controls[ZLFO_MIDI_MAX_RATE] = 1000.f;
+  host.controls[ZLFO_RANGE_MIN] = c->range_min;
+  host.controls[ZLFO_RANGE_MAX] = c->range_max;
+
+  float min_range = MIN (c->range_min, c->range_max);
+  float range =
+    MAX (c->range_min, c->range_max) - min_range;
+  int max_val =
+    c->expected_mode == MIDI_OUT_CC ? 127 : 16383;
+  uint8_t status =
+    c->expected_mode == MIDI_OUT_PITCH_BEND ?
+      LV2_MIDI_MSG_BENDER : LV2_MIDI_MSG_CONTROLLER;
+
+  int num_events = 0;
+  int min_val = max_val;
+  int max_seen = 0;
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      host_run (&host, BLOCK_SIZE);
+
+      /* 14-bit CCs are sent as an MSB and LSB
+       * pair */
+      int msb = -1;
+      LV2_ATOM_SEQUENCE_FOREACH (
+        host.atoms[ZLFO_MIDI_OUT], ev)
+        {
+          const uint8_t * msg =
+            (const uint8_t *) (&ev->body + 1);
+          if (ev->body.type != midi_event ||
+              ev->body.size != 3 ||
+              msg[0] !=
+                (status | c->expected_channel))
+            {
+              fprintf (
+                stderr,
+                "Mode %f, channel %f: invalid "
+                "event %02x\n",
+                (double) c->mode,
+                (double) c->channel, msg[0]);
+              return 1;
+            }
+
+          int val;
+          switch (c->expected_mode)
+            {
+            case MIDI_OUT_CC:
+              val = msg[2];
+              break;
+            case MIDI_OUT_CC_14BIT:
+              if (msb < 0)
+                {
+                  msb = msg[2];
+                  continue;
+                }
+              val = (msb << 7) | msg[2];
+              msb = -1;
+              break;
+            default:
+              val = (msg[2] << 7) | msg[1];
+              break;
+            }
+
+          float out =
+            host.cv[ZLFO_SINE_OUT][ev->time.frames];
+          int expected =
+            (int)
+            ((out - min_range) / range *
+               (float) max_val + 0.5f);
+          if (abs (val - expected) > 1)
+            {
+              fprintf (
+                stderr,
+                "Range %f to %f: expected %d for "
+                "%f, got %d\n",
+                (double) c->range_min,
+                (double) c->range_max, expected,
+                (double) out, val);
+              return 1;
+            }
+          min_val = MIN (min_val, val);
+          max_seen = MAX (max_seen, val);
+          num_events++;
+        }
+    }
+
+  host_cleanup (&host);
+
+  if (c->expected_mode == MIDI_OUT_OFF)
+    {
+      if (num_events > 0)
+        {
+          fprintf (
+            stderr, "Mode %f: sent %d events\n",
+            (double) c->mode, num_events);
+          return 1;
+        }
+      return 0;
+    }
+
+  /* the whole MIDI range is used */
+  if (min_val > max_val / 100 ||
+      max_seen < max_val - max_val / 100)
+    {
+      fprintf (
+        stderr,
+        "Range %f to %f: sent %d to %d of %d\n",
+        (double) c->range_min,
+        (double) c->range_max, min_val, max_seen,
+        max_val);
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  for (size_t i = 0;
+       i < sizeof (cases) / sizeof (MidiOutCase);
+       i++)
+    {
+      if (check_case (&cases[i]))
+        return 1;
+    }
+
+  return 0;
+}
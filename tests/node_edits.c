@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that the custom waveform follows node
+ * edits made between cycles, like a drag from the
+ * UI, including edits that change the node order
+ * and edits that leave the nodes as they were.
+ */
+
+#include "config.h"
+
+#include "lv2_host.h"
+#include "zlfo_math.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 400
+
+/**
+ * Sets the nodes for the given block.
+ *
+ * Node 2 is dragged across node 3 and back, and
+ * a node is added and removed now and then. The
+ * nodes stay the same for a few blocks in between.
+ */
+static void
+set_nodes (
+  Host * host,
+  int    block)
+{
+  int step = block / 4;
+  float pos =
+    (float) (step % 20) / 20.f;
+  host->controls[ZLFO_NODE_2_POS] = pos;
+  host->controls[ZLFO_NODE_2_VAL] = 1.f - pos;
+  host->controls[ZLFO_NUM_NODES] =
+    (step / 10) % 2 ? 4.f : 3.f;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  zlfo_tables_init ();
+
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    return 1;
+
+  host.controls[ZLFO_FREQ] = 7.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  host.controls[ZLFO_NODE_3_POS] = 0.5f;
+  host.controls[ZLFO_NODE_3_VAL] = 0.2f;
+  host.controls[ZLFO_NODE_4_POS] = 0.9f;
+  host.controls[ZLFO_NODE_4_VAL] = 0.7f;
+
+  HostPosition host_pos;
+  memset (&host_pos, 0, sizeof (host_pos));
+
+  float expected[NUM_WAVEFORMS][BLOCK_SIZE];
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      set_nodes (&host, i);
+      host_run (&host, BLOCK_SIZE);
+
+      /* take the same snapshot as the plugin */
+      LfoParams params;
+      memset (&params, 0, sizeof (params));
+      set_params_timing (
+        &params, 1, host.controls[ZLFO_FREQ],
+        &host_pos,
+        (SyncRate) host.controls[ZLFO_SYNC_RATE],
+        (SyncRateType)
+        host.controls[ZLFO_SYNC_RATE_TYPE],
+        (float) SAMPLERATE);
+      params.enabled[WAVEFORM_CUSTOM] = 1;
+      params.shift = host.controls[ZLFO_SHIFT];
+      params.range_min =
+        host.controls[ZLFO_RANGE_MIN];
+      params.range_max =
+        host.controls[ZLFO_RANGE_MAX];
+      params.grid_step =
+        (GridStep) host.controls[ZLFO_GRID_STEP];
+      params.num_nodes =
+        (int) host.controls[ZLFO_NUM_NODES];
+      for (int j = 0; j < 16; j++)
+        {
+          for (int k = 0; k < 3; k++)
+            {
+              params.nodes[j][k] =
+                host.controls[
+                  ZLFO_NODE_1_POS + j * 3 + k];
+            }
+        }
+      prepare_params (&params);
+
+      float * outs[NUM_WAVEFORMS];
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          outs[j] = expected[j];
+        }
+      render_frames (
+        &params, (uint64_t) (i * BLOCK_SIZE),
+        BLOCK_SIZE, outs);
+
+      for (int j = 0; j < BLOCK_SIZE; j++)
+        {
+          if (memcmp (
+                &expected[WAVEFORM_CUSTOM][j],
+                &host.cv[ZLFO_CUSTOM_OUT][j],
+                sizeof (float)))
+            {
+              fprintf (
+                stderr,
+                "Block %d at frame %d: expected "
+                "%f, got %f\n",
+                i, j,
+                (double)
+                expected[WAVEFORM_CUSTOM][j],
+                (double) host.cv[ZLFO_CUSTOM_OUT][j]);
+              return 1;
+            }
+        }
+    }
+
+  host_cleanup (&host);
+
+  return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that the playhead is sent to the UI at
+ * the rate of the UI update rate port, and that it
+ * stays exact for periods longer than a float can
+ * represent.
+ *
+ * Also checks that the unused sample_to_ui output
+ * is written every cycle and never changes, so
+ * that it causes no UI traffic.
+ */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <math.h>
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 1000
+
+/** UI update rates to check, in Hz. */
+static const float rates[] = {
+  DEF_UI_UPDATE_RATE, 30.f, 1.f, };
+
+/** 128 bars at 40 BPM are about 36.9M samples,
+ * past 2^24. */
+#define BPM 40.f
+#define BEAT_UNIT 4
+
+/** Start past 2^24 so the positions are not
+ * representable as floats. */
+#define START_FRAME ((1L << 24) + 3)
+
+/**
+ * Runs a block and returns the number of playhead
+ * objects in the notify output, storing the last
+ * one in @p playhead.
+ */
+static int
+run_and_get_playheads (
+  Host *     host,
+  ZLfoUris * uris,
+  Playhead * playhead)
+{
+  host->controls[ZLFO_SAMPLE_TO_UI] = NAN;
+  host_run (host, BLOCK_SIZE);
+  if (!isfinite (host->controls[ZLFO_SAMPLE_TO_UI]) ||
+      host->controls[ZLFO_SAMPLE_TO_UI] > 0.f ||
+      host->controls[ZLFO_SAMPLE_TO_UI] < 0.f)
+    {
+      fprintf (
+        stderr, "sample_to_ui is not 0\n");
+      exit (1);
+    }
+
+  int count = 0;
+  LV2_ATOM_SEQUENCE_FOREACH (
+    host->atoms[ZLFO_NOTIFY], ev)
+    {
+      const LV2_Atom_Object * obj =
+        (const LV2_Atom_Object *) &ev->body;
+      if (obj->body.otype == uris->playhead)
+        {
+          if (update_playhead_from_atom_obj (
+                playhead, uris, obj))
+            {
+              fprintf (
+                stderr, "Invalid playhead object\n");
+              exit (1);
+            }
+          count++;
+        }
+    }
+  return count;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    return 1;
+
+  ZLfoUris uris;
+  map_uris (&host.map, &uris);
+
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_FREE_RUNNING] = 0.f;
+  host.controls[ZLFO_SYNC_RATE] =
+    (float) SYNC_128_1;
+  host.controls[ZLFO_SYNC_RATE_TYPE] =
+    (float) SYNC_TYPE_NORMAL;
+
+  /* nothing is sent without a UI */
+  Playhead playhead;
+  for (int i = 0; i < 100; i++)
+    {
+      if (run_and_get_playheads (
+            &host, &uris, &playhead))
+        {
+          fprintf (stderr, "Sent without a UI\n");
+          return 1;
+        }
+    }
+  int64_t time_before_position =
+    100 * BLOCK_SIZE;
+
+  host_send_message (&host, 0, LFO_URI "#ui_on");
+  host_send_position (
+    &host, 0, START_FRAME, BPM, BEAT_UNIT, 1.f);
+
+  int64_t period_size = 0;
+  for (size_t r = 0;
+       r < sizeof (rates) / sizeof (float); r++)
+    {
+      host.controls[ZLFO_UI_UPDATE_RATE] = rates[r];
+
+      int num_updates = 0;
+      for (int i = 0; i < NUM_BLOCKS; i++)
+        {
+          if (!run_and_get_playheads (
+                &host, &uris, &playhead))
+            continue;
+
+          num_updates++;
+          if (period_size == 0)
+            {
+              period_size = playhead.period_size;
+              if (period_size <= (1L << 24))
+                {
+                  fprintf (
+                    stderr,
+                    "Period size %" PRId64 " is "
+                    "too short for this test\n",
+                    period_size);
+                  return 1;
+                }
+            }
+
+          /* the LFO moves one sample per sample
+           * processed since the position was
+           * set */
+          int64_t expected =
+            (START_FRAME % period_size +
+             (playhead.time -
+                time_before_position)) %
+            period_size;
+          if (playhead.period_size !=
+                period_size ||
+              playhead.current_sample != expected)
+            {
+              fprintf (
+                stderr,
+                "Expected sample %" PRId64 " of %"
+                PRId64 ", got %" PRId64 " of %"
+                PRId64 "\n",
+                expected, period_size,
+                playhead.current_sample,
+                playhead.period_size);
+              return 1;
+            }
+        }
+
+      /* about 5 seconds of audio */
+      int expected_updates =
+        (int)
+        ((NUM_BLOCKS * BLOCK_SIZE / SAMPLERATE) *
+         (double) rates[r]);
+      if (num_updates < expected_updates - 1 ||
+          num_updates > expected_updates + 1)
+        {
+          fprintf (
+            stderr,
+            "Expected %d updates at %f Hz, got "
+            "%d\n",
+            expected_updates, (double) rates[r],
+            num_updates);
+          return 1;
+        }
+    }
+
+  host_cleanup (&host);
+
+  return 0;
+}
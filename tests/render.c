@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that rendering arbitrary frame ranges
+ * with render_frames() matches the output of the
+ * plugin.
+ */
+
+#include "config.h"
+
+#include "lv2_host.h"
+#include "zlfo_math.h"
+
+#define SAMPLERATE 48000.0
+#define BLOCK_SIZE 256
+#define NUM_BLOCKS 200
+#define NUM_FRAMES (BLOCK_SIZE * NUM_BLOCKS)
+
+/** Size of the chunks rendered with
+ * render_frames(), not a divisor of the block
+ * size on purpose. */
+#define CHUNK_SIZE 1000
+
+static int
+check (
+  float freq,
+  int   step_mode,
+  int   hinvert,
+  int   vinvert,
+  float shift)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, BLOCK_SIZE))
+    exit (1);
+
+  host.controls[ZLFO_FREQ] = freq;
+  host.controls[ZLFO_STEP_MODE] = (float) step_mode;
+  host.controls[ZLFO_HINVERT] = (float) hinvert;
+  host.controls[ZLFO_VINVERT] = (float) vinvert;
+  host.controls[ZLFO_SHIFT] = shift;
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SAW_TOGGLE] = 1.f;
+  host.controls[ZLFO_TRIANGLE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SQUARE_TOGGLE] = 1.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  host.controls[ZLFO_NUM_NODES] = 3.f;
+  host.controls[ZLFO_NODE_2_POS] = 0.3f;
+  host.controls[ZLFO_NODE_2_VAL] = 0.2f;
+  host.controls[ZLFO_NODE_3_POS] = 0.8f;
+  host.controls[ZLFO_NODE_3_VAL] = 0.9f;
+
+  static const int ports[NUM_WAVEFORMS] = {
+    ZLFO_SINE_OUT, ZLFO_TRIANGLE_OUT,
+    ZLFO_SAW_OUT, ZLFO_SQUARE_OUT,
+    ZLFO_CUSTOM_OUT, };
+
+  /* run the plugin */
+  float * expected[NUM_WAVEFORMS];
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      expected[i] =
+        calloc (NUM_FRAMES, sizeof (float));
+    }
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      host_run (&host, BLOCK_SIZE);
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          memcpy (
+            &expected[j][i * BLOCK_SIZE],
+            host.cv[ports[j]],
+            BLOCK_SIZE * sizeof (float));
+        }
+    }
+
+  /* take the same snapshot as the plugin */
+  LfoParams params;
+  memset (&params, 0, sizeof (params));
+  HostPosition host_pos;
+  memset (&host_pos, 0, sizeof (host_pos));
+  set_params_timing (
+    &params, 1, freq, &host_pos,
+    (SyncRate) host.controls[ZLFO_SYNC_RATE],
+    (SyncRateType)
+    host.controls[ZLFO_SYNC_RATE_TYPE],
+    (float) SAMPLERATE);
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      params.enabled[i] = 1;
+    }
+  params.hinvert = hinvert;
+  params.vinvert = vinvert;
+  params.step_mode = step_mode;
+  params.shift = shift;
+  params.range_min = host.controls[ZLFO_RANGE_MIN];
+  params.range_max = host.controls[ZLFO_RANGE_MAX];
+  params.grid_step =
+    (GridStep) host.controls[ZLFO_GRID_STEP];
+  params.num_nodes =
+    (int) host.controls[ZLFO_NUM_NODES];
+  for (int i = 0; i < 16; i++)
+    {
+      for (int j = 0; j < 3; j++)
+        {
+          params.nodes[i][j] =
+            host.controls[ZLFO_NODE_1_POS + i * 3 + j];
+        }
+    }
+  prepare_params (&params);
+
+  /* render the chunks backwards to make sure they
+   * don't depend on each other */
+  float * actual[NUM_WAVEFORMS];
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      actual[i] =
+        calloc (NUM_FRAMES, sizeof (float));
+    }
+  int start = (NUM_FRAMES / CHUNK_SIZE) * CHUNK_SIZE;
+  for (; start >= 0; start -= CHUNK_SIZE)
+    {
+      int n_frames =
+        MIN (CHUNK_SIZE, NUM_FRAMES - start);
+      float * outs[NUM_WAVEFORMS];
+      for (int i = 0; i < NUM_WAVEFORMS; i++)
+        {
+          outs[i] = &actual[i][start];
+        }
+      render_frames (
+        &params, (uint64_t) start,
+        (uint32_t) n_frames, outs);
+    }
+
+  int ret = 0;
+  for (int i = 0; i < NUM_WAVEFORMS && !ret; i++)
+    {
+      for (int j = 0; j < NUM_FRAMES; j++)
+        {
+          if (memcmp (
+                &expected[i][j], &actual[i][j],
+                sizeof (float)))
+            {
+              fprintf (
+                stderr,
+                "Waveform %d at frame %d: "
+                "expected %f, got %f\n",
+                i, j, (double) expected[i][j],
+                (double) actual[i][j]);
+              ret = -1;
+              break;
+            }
+        }
+    }
+
+  for (int i = 0; i < NUM_WAVEFORMS; i++)
+    {
+      free (expected[i]);
+      free (actual[i]);
+    }
+  host_cleanup (&host);
+
+  return ret;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  zlfo_tables_init ();
+
+  if (check (DEF_FREQ, 0, 0, 0, 0.5f) ||
+      check (MAX_FREQ, 0, 1, 0, 0.2f) ||
+      check (3.3f, 1, 0, 1, 0.7f) ||
+      check (MIN_FREQ, 1, 1, 1, 0.f))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that run() is real-time safe.
+ *
+ * The allocation, I/O and locking functions are
+ * interposed by this executable (it is linked with
+ * -rdynamic so that the plugin resolves them here)
+ * and any call made while run() is executing is
+ * reported. run() is driven through all the modes
+ * and sweeps of the parameters, and the worst-case
+ * duration of a cycle is bounded.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+#define MAX_BLOCK_SIZE 4096
+#define NUM_BLOCKS 200
+
+/** Sweeps are repeated this many times and the
+ * smallest worst case is kept, so that a single
+ * preemption by the OS doesn't fail the test. */
+#define NUM_REPEATS 3
+
+/** Max allowed duration of a cycle, in ns. This
+ * is very generous, the point is to catch
+ * unbounded work (e.g. blocking or work that
+ * depends on more than the block size). */
+#define MAX_RUN_NS(n_samples) \
+  (200000.0 + 2000.0 * (double) (n_samples))
+
+#define INTERPOSE \
+  __attribute__ ((visibility ("default")))
+
+/* the real allocator */
+extern void * __libc_malloc (size_t size);
+extern void * __libc_calloc (size_t nmemb, size_t size);
+extern void * __libc_realloc (void * ptr, size_t size);
+extern void   __libc_free (void * ptr);
+
+typedef enum RtViolation
+{
+  RT_MALLOC,
+  RT_CALLOC,
+  RT_REALLOC,
+  RT_FREE,
+  RT_WRITE,
+  RT_STDIO,
+  RT_MUTEX_LOCK,
+  RT_RWLOCK,
+  RT_COND_WAIT,
+  RT_SEM_WAIT,
+  NUM_RT_VIOLATIONS,
+} RtViolation;
+
+static const char * rt_violation_strings[] = {
+  "malloc",
+  "calloc",
+  "realloc",
+  "free",
+  "write",
+  "stdio",
+  "pthread_mutex_lock",
+  "pthread_rwlock_*lock",
+  "pthread_cond_wait",
+  "sem_wait",
+};
+
+/** Set while run() is executing. */
+static volatile int in_run = 0;
+
+/** Number of calls made during run(). */
+static int violations[NUM_RT_VIOLATIONS];
+
+/* resolved before anything else in main() since
+ * dlsym() itself may allocate */
+static int (*real_vfprintf) (
+  FILE *, const char *, va_list);
+static size_t (*real_fwrite) (
+  const void *, size_t, size_t, FILE *);
+static int (*real_fputs) (const char *, FILE *);
+static int (*real_fputc) (int, FILE *);
+static int (*real_puts) (const char *);
+static int (*real_pthread_mutex_lock) (
+  pthread_mutex_t *);
+static int (*real_pthread_mutex_trylock) (
+  pthread_mutex_t *);
+static int (*real_pthread_rwlock_rdlock) (
+  pthread_rwlock_t *);
+static int (*real_pthread_rwlock_wrlock) (
+  pthread_rwlock_t *);
+static int (*real_pthread_cond_wait) (
+  pthread_cond_t *, pthread_mutex_t *);
+static int (*real_sem_wait) (sem_t *);
+
+/**
+ * Records a call if run() is executing.
+ *
+ * This must not call any of the interposed
+ * functions.
+ */
+static inline void
+check_rt (
+  RtViolation violation)
+{
+  if (in_run)
+    violations[violation]++;
+}
+
+INTERPOSE void *
+malloc (
+  size_t size)
+{
+  check_rt (RT_MALLOC);
+  return __libc_malloc (size);
+}
+
+INTERPOSE void *
+calloc (
+  size_t nmemb,
+  size_t size)
+{
+  check_rt (RT_CALLOC);
+  return __libc_calloc (nmemb, size);
+}
+
+INTERPOSE void *
+realloc (
+  void * ptr,
+  size_t size)
+{
+  check_rt (RT_REALLOC);
+  return __libc_realloc (ptr, size);
+}
+
+INTERPOSE void
+free (
+  void * ptr)
+{
+  check_rt (RT_FREE);
+  __libc_free (ptr);
+}
+
+INTERPOSE ssize_t
+write (
+  int          fd,
+  const void * buf,
+  size_t       count)
+{
+  check_rt (RT_WRITE);
+  return syscall (SYS_write, fd, buf, count);
+}
+
+INTERPOSE int
+fprintf (
+  FILE *       stream,
+  const char * format,
+  ...)
+{
+  check_rt (RT_STDIO);
+  va_list args;
+  va_start (args, format);
+  int ret = real_vfprintf (stream, format, args);
+  va_end (args);
+  return ret;
+}
+
+INTERPOSE int
+printf (
+  const char * format,
+  ...)
+{
+  check_rt (RT_STDIO);
+  va_list args;
+  va_start (args, format);
+  int ret = real_vfprintf (stdout, format, args);
+  va_end (args);
+  return ret;
+}
+
+INTERPOSE size_t
+fwrite (
+  const void * ptr,
+  size_t       size,
+  size_t       nmemb,
+  FILE *       stream)
+{
+  check_rt (RT_STDIO);
+  return real_fwrite (ptr, size, nmemb, stream);
+}
+
+INTERPOSE int
+fputs (
+  const char * s,
+  FILE *       stream)
+{
+  check_rt (RT_STDIO);
+  return real_fputs (s, stream);
+}
+
+INTERPOSE int
+fputc (
+  int    c,
+  FILE * stream)
+{
+  check_rt (RT_STDIO);
+  return real_fputc (c, stream);
+}
+
+INTERPOSE int
+puts (
+  const char * s)
+{
+  check_rt (RT_STDIO);
+  return real_puts (s);
+}
+
+INTERPOSE int
+pthread_mutex_lock (
+  pthread_mutex_t * mutex)
+{
+  check_rt (RT_MUTEX_LOCK);
+  return real_pthread_mutex_lock (mutex);
+}
+
+INTERPOSE int
+pthread_mutex_trylock (
+  pthread_mutex_t * mutex)
+{
+  check_rt (RT_MUTEX_LOCK);
+  return real_pthread_mutex_trylock (mutex);
+}
+
+INTERPOSE int
+pthread_rwlock_rdlock (
+  pthread_rwlock_t * rwlock)
+{
+  check_rt (RT_RWLOCK);
+  return real_pthread_rwlock_rdlock (rwlock);
+}
+
+INTERPOSE int
+pthread_rwlock_wrlock (
+  pthread_rwlock_t * rwlock)
+{
+  check_rt (RT_RWLOCK);
+  return real_pthread_rwlock_wrlock (rwlock);
+}
+
+INTERPOSE int
+pthread_cond_wait (
+  pthread_cond_t *  cond,
+  pthread_mutex_t * mutex)
+{
+  check_rt (RT_COND_WAIT);
+  return real_pthread_cond_wait (cond, mutex);
+}
+
+INTERPOSE int
+sem_wait (
+  sem_t * sem)
+{
+  check_rt (RT_SEM_WAIT);
+  return real_sem_wait (sem);
+}
+
+#define RESOLVE(x) \
+  *(void **) (&real_##x) = dlsym (RTLD_NEXT, #x); \
+  if (!real_##x) \
+    return -1
+
+static int
+resolve_real_functions (void)
+{
+  RESOLVE (vfprintf);
+  RESOLVE (fwrite);
+  RESOLVE (fputs);
+  RESOLVE (fputc);
+  RESOLVE (puts);
+  RESOLVE (pthread_mutex_lock);
+  RESOLVE (pthread_mutex_trylock);
+  RESOLVE (pthread_rwlock_rdlock);
+  RESOLVE (pthread_rwlock_wrlock);
+  RESOLVE (pthread_cond_wait);
+  RESOLVE (sem_wait);
+
+  return 0;
+}
+
+#undef RESOLVE
+
+/**
+ * How the transport and the gate are driven.
+ */
+typedef enum SweepMode
+{
+  SWEEP_FREE_RUNNING,
+  SWEEP_SYNCED,
+  /** Synced but the host never sends the time
+   * info. */
+  SWEEP_SYNCED_NO_POSITION,
+  SWEEP_GATED,
+  SWEEP_CV_GATE,
+  SWEEP_TRIGGERS,
+  NUM_SWEEP_MODES,
+} SweepMode;
+
+static const char * sweep_mode_strings[] = {
+  "free running",
+  "synced",
+  "synced without position",
+  "gated",
+  "CV gate",
+  "triggers",
+};
+
+/** Block sizes to cycle through. */
+static const uint32_t block_sizes[] = {
+  1, 7, 64, 256, 1000, MAX_BLOCK_SIZE,
+};
+#define NUM_BLOCK_SIZES \
+  (sizeof (block_sizes) / sizeof (uint32_t))
+
+/**
+ * Deterministic pseudo-random number in [0, 1).
+ */
+static float
+next_rand (
+  uint32_t * state)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return (float) (*state >> 8) / 16777216.f;
+}
+
+/**
+ * Changes the parameters for the next block, the
+ * same way for every repeat.
+ */
+static void
+sweep_params (
+  Host *    host,
+  SweepMode mode,
+  int       block,
+  uint32_t  n_samples,
+  uint32_t * rand_state)
+{
+  float * c = host->controls;
+
+  /* exponential sweep of the frequency */
+  c[ZLFO_FREQ] =
+    MIN_FREQ *
+    powf (
+      MAX_FREQ / MIN_FREQ,
+      (float) block / (float) NUM_BLOCKS);
+  c[ZLFO_SYNC_RATE] =
+    (float) (block % NUM_SYNC_RATES);
+  c[ZLFO_SYNC_RATE_TYPE] =
+    (float) (block % NUM_SYNC_RATE_TYPES);
+  c[ZLFO_GRID_STEP] =
+    (float) (block % NUM_GRID_STEPS);
+  c[ZLFO_STEP_MODE] = (float) ((block / 3) % 2);
+  c[ZLFO_HINVERT] = (float) ((block / 5) % 2);
+  c[ZLFO_VINVERT] = (float) ((block / 7) % 2);
+  c[ZLFO_SHIFT] = 100.f * next_rand (rand_state);
+  c[ZLFO_RANGE_MIN] = - next_rand (rand_state);
+  c[ZLFO_RANGE_MAX] = next_rand (rand_state);
+  c[ZLFO_SINE_TOGGLE] = (float) ((block / 2) % 2);
+  c[ZLFO_SAW_TOGGLE] = (float) ((block / 4) % 2);
+  c[ZLFO_SQUARE_TOGGLE] = (float) ((block / 8) % 2);
+  c[ZLFO_TRIANGLE_TOGGLE] =
+    (float) ((block / 16) % 2);
+  c[ZLFO_CUSTOM_TOGGLE] = 1.f;
+
+  /* nodes in random order */
+  c[ZLFO_NUM_NODES] = (float) (1 + block % 16);
+  for (int i = 0; i < 16; i++)
+    {
+      c[ZLFO_NODE_1_POS + i * 3] =
+        next_rand (rand_state);
+      c[ZLFO_NODE_1_VAL + i * 3] =
+        next_rand (rand_state);
+    }
+
+  c[ZLFO_MIDI_MODE] =
+    (float) (block % NUM_MIDI_OUT_MODES);
+  c[ZLFO_MIDI_SOURCE] =
+    (float) (block % NUM_WAVEFORMS);
+  c[ZLFO_MIDI_MAX_RATE] =
+    (block % 2) ? 0.f : 1000.f;
+  c[ZLFO_BREAKPOINTS_TOGGLE] =
+    (float) ((block / 2) % 2);
+  c[ZLFO_BREAKPOINTS_TOLERANCE] =
+    (block % 3) ? 0.001f : 0.00001f;
+  c[ZLFO_UI_UPDATE_RATE] =
+    (block % 2) ? 0.f : MAX_UI_UPDATE_RATE;
+
+  c[ZLFO_FREE_RUNNING] =
+    (mode == SWEEP_SYNCED ||
+     mode == SWEEP_SYNCED_NO_POSITION) ?
+      0.f : 1.f;
+  c[ZLFO_GATED_MODE] =
+    (mode == SWEEP_GATED ||
+     mode == SWEEP_CV_GATE) ?
+      1.f : 0.f;
+  c[ZLFO_GATE] = (float) ((block / 3) % 2);
+  c[ZLFO_TRIGGER] =
+    mode == SWEEP_TRIGGERS ?
+      (float) (block % 2) : 0.f;
+
+  for (uint32_t i = 0; i < n_samples; i++)
+    {
+      host->cv[ZLFO_CV_GATE][i] =
+        (mode == SWEEP_CV_GATE &&
+         (i / 32) % 2) ?
+          1.f : 0.f;
+      host->cv[ZLFO_CV_TRIGGER][i] =
+        (mode == SWEEP_TRIGGERS && i % 100 == 0) ?
+          1.f : 0.f;
+    }
+
+  /* the UI opens and closes */
+  if (block % 50 == 0)
+    {
+      host_send_message (
+        host, 0,
+        (block / 50) % 2 ?
+          LFO_URI "#ui_off" : LFO_URI "#ui_on");
+    }
+
+  if (mode == SWEEP_SYNCED)
+    {
+      host_send_position (
+        host, n_samples / 2,
+        (long) block * 1000,
+        60.f + (float) (block % 200), 4,
+        (float) ((block / 10) % 2));
+    }
+}
+
+/**
+ * Runs a sweep in the given mode and returns the
+ * worst ratio of the duration of run() to the
+ * allowed duration.
+ */
+static double
+run_sweep (
+  SweepMode mode)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, MAX_BLOCK_SIZE))
+    exit (1);
+
+  uint32_t rand_state = 1234;
+  double worst = 0.0;
+  for (int i = 0; i < NUM_BLOCKS; i++)
+    {
+      uint32_t n_samples =
+        block_sizes[(size_t) i % NUM_BLOCK_SIZES];
+      sweep_params (
+        &host, mode, i, n_samples, &rand_state);
+
+      double start = host_get_time_ns ();
+      in_run = 1;
+      host_run (&host, n_samples);
+      in_run = 0;
+      double ratio =
+        (host_get_time_ns () - start) /
+        MAX_RUN_NS (n_samples);
+      if (ratio > worst)
+        worst = ratio;
+    }
+
+  host_cleanup (&host);
+
+  return worst;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  if (resolve_real_functions ())
+    {
+      fprintf (
+        stderr, "Failed to resolve %s\n",
+        dlerror ());
+      return 1;
+    }
+
+  int ret = 0;
+  for (int mode = 0; mode < NUM_SWEEP_MODES; mode++)
+    {
+      memset (violations, 0, sizeof (violations));
+
+      double worst = 0.0;
+      for (int i = 0; i < NUM_REPEATS; i++)
+        {
+          double ratio = run_sweep ((SweepMode) mode);
+          if (i == 0 || ratio < worst)
+            worst = ratio;
+        }
+
+      printf (
+        "%s: worst case %.1f%% of the allowed "
+        "duration\n",
+        sweep_mode_strings[mode], 100.0 * worst);
+
+      for (int i = 0; i < NUM_RT_VIOLATIONS; i++)
+        {
+          if (violations[i] == 0)
+            continue;
+
+          fprintf (
+            stderr,
+            "%s: %s called %d times in run()\n",
+            sweep_mode_strings[mode],
+            rt_violation_strings[i],
+            violations[i]);
+          ret = 1;
+        }
+
+      if (worst > 1.0)
+        {
+          fprintf (
+            stderr,
+            "%s: run() took %.1fx longer than "
+            "allowed\n",
+            sweep_mode_strings[mode], worst);
+          ret = 1;
+        }
+    }
+
+  return ret;
+}
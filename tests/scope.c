@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Checks that the scope columns sent to the UI are
+ * the min and max of the outputs over each column,
+ * for several block sizes.
+ */
+
+#include "config.h"
+
+#include "lv2_host.h"
+
+#define SAMPLERATE 48000.0
+
+/** Samples to run for each block size. */
+#define NUM_SAMPLES 48000
+
+static const uint32_t block_sizes[] = {
+  1, 64, 256, 4096, };
+
+/** Outputs since the UI was turned on, per
+ * waveform. */
+static float outputs[NUM_WAVEFORMS][NUM_SAMPLES];
+
+/** Columns received. */
+static float columns[NUM_SAMPLES][NUM_WAVEFORMS][2];
+
+static int
+check_block_size (
+  uint32_t block_size)
+{
+  Host host;
+  if (host_init (&host, SAMPLERATE, block_size))
+    return 1;
+
+  ZLfoUris uris;
+  map_uris (&host.map, &uris);
+
+  host.controls[ZLFO_SINE_TOGGLE] = 1.f;
+  host.controls[ZLFO_SQUARE_TOGGLE] = 1.f;
+  host.controls[ZLFO_CUSTOM_TOGGLE] = 1.f;
+  host.controls[ZLFO_FREQ] = 3.f;
+
+  /* nothing is sent without a UI */
+  for (int i = 0; i < 100; i++)
+    {
+      host_run (&host, block_size);
+      LV2_ATOM_SEQUENCE_FOREACH (
+        host.atoms[ZLFO_NOTIFY], ev)
+        {
+          const LV2_Atom_Object * obj =
+            (const LV2_Atom_Object *) &ev->body;
+          if (obj->body.otype == uris.scope)
+            {
+              fprintf (
+                stderr, "Sent without a UI\n");
+              return 1;
+            }
+        }
+    }
+
+  host_send_message (&host, 0, LFO_URI "#ui_on");
+
+  const int waves[NUM_WAVEFORMS] = {
+    [WAVEFORM_SINE] = ZLFO_SINE_OUT,
+    [WAVEFORM_TRIANGLE] = ZLFO_TRIANGLE_OUT,
+    [WAVEFORM_SAW] = ZLFO_SAW_OUT,
+    [WAVEFORM_SQUARE] = ZLFO_SQUARE_OUT,
+    [WAVEFORM_CUSTOM] = ZLFO_CUSTOM_OUT,
+  };
+  int num_columns = 0;
+  int samples_per_column = 0;
+  for (uint32_t offset = 0;
+       offset + block_size <= NUM_SAMPLES;
+       offset += block_size)
+    {
+      host_run (&host, block_size);
+      if (sizeof (LV2_Atom) +
+            host.atoms[ZLFO_NOTIFY]->atom.size >
+          NOTIFY_MIN_SIZE)
+        {
+          fprintf (
+            stderr,
+            "Block size %u: notify output is "
+            "larger than its minimum size\n",
+            block_size);
+          return 1;
+        }
+      for (int i = 0; i < NUM_WAVEFORMS; i++)
+        {
+          memcpy (
+            &outputs[i][offset], host.cv[waves[i]],
+            block_size * sizeof (float));
+        }
+
+      LV2_ATOM_SEQUENCE_FOREACH (
+        host.atoms[ZLFO_NOTIFY], ev)
+        {
+          const LV2_Atom_Object * obj =
+            (const LV2_Atom_Object *) &ev->body;
+          if (obj->body.otype != uris.scope)
+            continue;
+
+          const LV2_Atom * spc = NULL;
+          lv2_atom_object_get (
+            obj, uris.scope_samples_per_column,
+            &spc, NULL);
+          const float * cols;
+          int n =
+            get_scope_columns_from_atom_obj (
+              &uris, obj, &cols);
+          if (n <= 0 || !spc ||
+              spc->type != uris.atom_Int)
+            {
+              fprintf (
+                stderr, "Invalid scope object\n");
+              return 1;
+            }
+          samples_per_column =
+            ((const LV2_Atom_Int *) spc)->body;
+          memcpy (
+            columns[num_columns], cols,
+            (size_t) n * sizeof (columns[0]));
+          num_columns += n;
+        }
+    }
+
+  host_cleanup (&host);
+
+  /* the period is the same all along, so every
+   * column spans the same samples */
+  int expected =
+    (int)
+    ((NUM_SAMPLES / block_size) * block_size /
+     (uint32_t) samples_per_column);
+  if (num_columns < expected - SCOPE_RING_SIZE ||
+      num_columns > expected)
+    {
+      fprintf (
+        stderr,
+        "Block size %u: expected about %d "
+        "columns, got %d\n",
+        block_size, expected, num_columns);
+      return 1;
+    }
+
+  for (int i = 0; i < num_columns; i++)
+    {
+      for (int j = 0; j < NUM_WAVEFORMS; j++)
+        {
+          const float * samples =
+            &outputs[j][i * samples_per_column];
+          float min = samples[0];
+          float max = samples[0];
+          for (int k = 1; k < samples_per_column;
+               k++)
+            {
+              min = MIN (min, samples[k]);
+              max = MAX (max, samples[k]);
+            }
+          /* the columns must be exact */
+          if (memcmp (
+                &min, &columns[i][j][0],
+                sizeof (float)) != 0 ||
+              memcmp (
+                &max, &columns[i][j][1],
+                sizeof (float)) != 0)
+            {
+              fprintf (
+                stderr,
+                "Block size %u: column %d of "
+                "waveform %d is %f to %f, "
+                "expected %f to %f\n",
+                block_size, i, j,
+                (double) columns[i][j][0],
+                (double) columns[i][j][1],
+                (double) min, (double) max);
+              return 1;
+            }
+        }
+    }
+
+  printf (
+    "Block size %u: %d columns of %d samples\n",
+    block_size, num_columns, samples_per_column);
+
+  return 0;
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  for (size_t i = 0;
+       i < sizeof (block_sizes) / sizeof (uint32_t);
+       i++)
+    {
+      if (check_block_size (block_sizes[i]))
+        return 1;
+    }
+
+  return 0;
+}
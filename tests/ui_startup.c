@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2020 Alexandros Theodotou <alex at zrythm dot org>
+ *
+ * This file is part of ZLFO
+ *
+ * ZLFO is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * ZLFO is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Affero Public License
+ * along with ZLFO.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ *
+ * Benchmark of the UI startup work that does not
+ * need a window: setting up the theme and drawing
+ * the icons visible on open to an offscreen image
+ * surface.
+ *
+ * The first UI in the process parses the SVGs.
+ * Later UIs of the same bundle share them, so
+ * they should only pay for rasterizing the icons.
+ *
+ * Usage: ui_startup <bundle path with resources/>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "zlfo_ui_theme.h"
+
+#include <cairo.h>
+
+/** Size of the UI. */
+#define WIDTH 480
+#define HEIGHT 261
+
+/** Size to draw each icon at. */
+#define ICON_SIZE 32
+
+/** UIs to open after the first one. */
+#define NUM_INSTANCES 100
+
+static double
+get_time_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return
+    (double) ts.tv_sec * 1000000000.0 +
+    (double) ts.tv_nsec;
+}
+
+/**
+ * Sets up a theme and draws each icon visible on
+ * open, like the UI does on its first expose.
+ */
+static void
+open_ui (
+  ZLfoUiTheme * theme,
+  const char *  bundle_path,
+  cairo_t *     cr)
+{
+  zlfo_ui_theme_init (theme, bundle_path);
+
+  const int icons_per_row = WIDTH / ICON_SIZE;
+  for (int i = 0; i < SVG_FIRST_LAZY; i++)
+    {
+      ZtkRect rect = {
+        (i % icons_per_row) * ICON_SIZE,
+        (i / icons_per_row) * ICON_SIZE,
+        ICON_SIZE, ICON_SIZE };
+      zlfo_ui_theme_draw_svg (
+        theme, (ZLfoSvg) i, cr, &rect);
+    }
+  cairo_surface_flush (cairo_get_target (cr));
+}
+
+int
+main (
+  int          argc,
+  const char * argv[])
+{
+  if (argc != 2)
+    {
+      fprintf (
+        stderr, "Usage: %s <bundle path>\n",
+        argv[0]);
+      return 1;
+    }
+  const char * bundle_path = argv[1];
+
+  cairo_surface_t * surface =
+    cairo_image_surface_create (
+      CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+  cairo_t * cr = cairo_create (surface);
+
+  /* first UI in the process */
+  ZLfoUiTheme first;
+  memset (&first, 0, sizeof (ZLfoUiTheme));
+  double start = get_time_ns ();
+  open_ui (&first, bundle_path, cr);
+  double first_ns = get_time_ns () - start;
+
+  /* later UIs while the first one is open */
+  static ZLfoUiTheme themes[NUM_INSTANCES];
+  start = get_time_ns ();
+  for (int i = 0; i < NUM_INSTANCES; i++)
+    {
+      open_ui (&themes[i], bundle_path, cr);
+    }
+  double later_ns =
+    (get_time_ns () - start) / NUM_INSTANCES;
+
+  for (int i = 0; i < NUM_INSTANCES; i++)
+    {
+      zlfo_ui_theme_cleanup (&themes[i]);
+    }
+  zlfo_ui_theme_cleanup (&first);
+
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  printf ("ui,ms\n");
+  printf ("first,%.3f\n", first_ns / 1000000.0);
+  printf ("later,%.3f\n", later_ns / 1000000.0);
+
+  return 0;
+}